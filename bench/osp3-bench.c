@@ -0,0 +1,455 @@
+/**
+ * Microbenchmarks for parsing, checksumming, and line assembly.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+// For posix_openpt, grantpt, unlockpt, and ptsname.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <osp3.h>
+#include "osp3sim.h"
+
+// Storage per corpus line, large enough for a faulted line and a NUL terminator.
+#define SLOT_SIZE 256
+
+#define LINES_DEFAULT 10000
+#define MIN_MS_DEFAULT 200
+
+// Reads after the last line wait this long to confirm the pty is drained.
+#define PTY_DRAIN_MS 100
+
+// How long the pty writer waits for the reader to make room.
+#define PTY_STALL_MS 1000
+
+typedef enum corpus_shape {
+  // Channels off and zero-valued.
+  CORPUS_ZERO,
+  // Varying load on both channels.
+  CORPUS_BUSY,
+  // Checksums (and interrupt fields) with hexadecimal letters.
+  CORPUS_HEX,
+  // Busy lines with corrupted, truncated, and noisy lines mixed in.
+  CORPUS_NOISY,
+  CORPUS_COUNT
+} corpus_shape;
+
+static const char* const corpus_names[] = {
+  [CORPUS_ZERO] = "zero",
+  [CORPUS_BUSY] = "busy",
+  [CORPUS_HEX] = "hex",
+  [CORPUS_NOISY] = "noisy",
+};
+
+typedef struct corpus {
+  // NUL-terminated lines, each in a `SLOT_SIZE` slot.
+  char* slots;
+  size_t* lens;
+  // Expected checksums, as parsed from each line.
+  uint8_t* cs8_2s;
+  uint8_t* cs8_xor;
+  // All lines back-to-back, as they'd be received.
+  char* stream;
+  size_t stream_len;
+  unsigned long count;
+} corpus;
+
+typedef int (*bench_fn)(const corpus* c, unsigned long* lines, uint64_t* ns);
+
+typedef struct bench {
+  const char* name;
+  bench_fn fn;
+} bench;
+
+static unsigned long count = LINES_DEFAULT;
+static unsigned int min_ms = MIN_MS_DEFAULT;
+static size_t packet_size = OSP3_W_MAX_PACKET_SIZE;
+static const char* corpus_filter = NULL;
+static const char* bench_filter = NULL;
+static int json = 0;
+
+// Consumes results so the compiler can't discard the benchmarked work.
+static volatile unsigned long sink;
+
+static const char short_options[] = "hn:t:s:c:b:j";
+static const struct option long_options[] = {
+  {"help",        no_argument,       NULL, 'h'},
+  {"lines",       required_argument, NULL, 'n'},
+  {"min-ms",      required_argument, NULL, 't'},
+  {"packet-size", required_argument, NULL, 's'},
+  {"corpus",      required_argument, NULL, 'c'},
+  {"bench",       required_argument, NULL, 'b'},
+  {"json",        no_argument,       NULL, 'j'},
+  {0, 0, 0, 0}
+};
+
+__attribute__ ((noreturn))
+static void print_usage(int exit_code) {
+  fprintf(exit_code ? stderr : stdout,
+          "Benchmark OSP3 log parsing, checksumming, and line assembly.\n\n"
+          "Usage: osp3-bench [OPTION]...\n"
+          "Options:\n"
+          "  -h, --help               Print this message and exit\n"
+          "  -n, --lines=N            Lines per corpus (default: %u)\n"
+          "  -t, --min-ms=MS          Repeat each benchmark for at least MS milliseconds (default: %u)\n"
+          "  -s, --packet-size=BYTES  Maximum bytes per read for line assembly benchmarks (default: %u)\n"
+          "  -c, --corpus=NAME        Only use one corpus: zero, busy, hex, noisy\n"
+          "  -b, --bench=NAME         Only run one benchmark: parse, checksum, checksum_test, read_line_mem,\n"
+          "                           read_line_pty\n"
+          "  -j, --json               Print results as JSON\n",
+          LINES_DEFAULT, MIN_MS_DEFAULT, OSP3_W_MAX_PACKET_SIZE);
+  exit(exit_code);
+}
+
+static void parse_args(int argc, char** argv) {
+  int c;
+  while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+    switch (c) {
+      case 'h':
+        print_usage(0);
+        break;
+      case 'n':
+        count = strtoul(optarg, NULL, 0);
+        break;
+      case 't':
+        min_ms = (unsigned int) atoi(optarg);
+        break;
+      case 's':
+        packet_size = (size_t) atoi(optarg);
+        break;
+      case 'c':
+        corpus_filter = optarg;
+        break;
+      case 'b':
+        bench_filter = optarg;
+        break;
+      case 'j':
+        json = 1;
+        break;
+      case '?':
+      default:
+        print_usage(1);
+        break;
+    }
+  }
+  if (count == 0 || packet_size == 0) {
+    print_usage(1);
+  }
+}
+
+static int has_hex_letter(uint8_t val) {
+  return (val >> 4) > 9 || (val & 0xF) > 9;
+}
+
+static int corpus_init(corpus* c, corpus_shape shape, unsigned long n) {
+  osp3sim_config cfg;
+  osp3sim_gen gen;
+  osp3_log_entry entry;
+  char line[OSP3_LOG_PROTOCOL_SIZE];
+  char faulty[OSP3SIM_FAULTS_OUT_MAX];
+  osp3sim_config_init(&cfg);
+  switch (shape) {
+    case CORPUS_ZERO:
+      cfg.waveform = OSP3SIM_WAVEFORM_IDLE;
+      break;
+    case CORPUS_HEX:
+      cfg.waveform = OSP3SIM_WAVEFORM_RANDOM;
+      break;
+    case CORPUS_NOISY:
+      cfg.faults.flip_ppm = 1000;
+      cfg.faults.dup_ppm = 200;
+      cfg.faults.truncate_ppm = 20000;
+      cfg.faults.burst_ppm = 20000;
+      cfg.faults.burst_len = 64;
+      break;
+    case CORPUS_BUSY:
+    case CORPUS_COUNT:
+    default:
+      break;
+  }
+  osp3sim_gen_init(&gen, &cfg);
+  uint32_t fault_rng = ~gen.rng;
+  memset(c, 0, sizeof(*c));
+  if ((c->slots = calloc(n, SLOT_SIZE)) == NULL ||
+      (c->lens = calloc(n, sizeof(*c->lens))) == NULL ||
+      (c->cs8_2s = calloc(n, sizeof(*c->cs8_2s))) == NULL ||
+      (c->cs8_xor = calloc(n, sizeof(*c->cs8_xor))) == NULL ||
+      (c->stream = malloc(n * SLOT_SIZE)) == NULL) {
+    return -1;
+  }
+  while (c->count < n) {
+    char* slot = &c->slots[c->count * SLOT_SIZE];
+    size_t len = OSP3_LOG_PROTOCOL_SIZE;
+    osp3sim_gen_next(&gen, &entry);
+    if (shape == CORPUS_HEX) {
+      entry.intr_0 = osp3sim_rand(&gen.rng) & 0xFF;
+      entry.intr_1 = osp3sim_rand(&gen.rng) & 0xFF;
+    }
+    if (osp3_log_format(&entry, line) < 0 ||
+        osp3_log_checksum(line, sizeof(line), &c->cs8_2s[c->count], &c->cs8_xor[c->count]) < 0) {
+      return -1;
+    }
+    if (shape == CORPUS_HEX && !(has_hex_letter(c->cs8_2s[c->count]) && has_hex_letter(c->cs8_xor[c->count]))) {
+      continue;
+    }
+    if (osp3sim_faults_apply(&cfg.faults, &fault_rng, line, len, faulty, &len)) {
+      memcpy(slot, faulty, len < SLOT_SIZE ? len : SLOT_SIZE - 1);
+    } else {
+      memcpy(slot, line, len);
+    }
+    c->lens[c->count] = len < SLOT_SIZE ? len : SLOT_SIZE - 1;
+    memcpy(&c->stream[c->stream_len], slot, c->lens[c->count]);
+    c->stream_len += c->lens[c->count];
+    c->count++;
+  }
+  return 0;
+}
+
+static void corpus_destroy(corpus* c) {
+  free(c->slots);
+  free(c->lens);
+  free(c->cs8_2s);
+  free(c->cs8_xor);
+  free(c->stream);
+}
+
+static int bench_parse(const corpus* c, unsigned long* lines, uint64_t* ns) {
+  osp3_log_entry entry;
+  unsigned long ok = 0;
+  const uint64_t start = osp3sim_now_ns();
+  for (unsigned long i = 0; i < c->count; i++) {
+    ok += osp3_log_parse(&c->slots[i * SLOT_SIZE], SLOT_SIZE, &entry) == 0;
+  }
+  *ns = osp3sim_now_ns() - start;
+  *lines = c->count;
+  sink += ok;
+  return 0;
+}
+
+static int bench_checksum(const corpus* c, unsigned long* lines, uint64_t* ns) {
+  uint8_t cs8_2s;
+  uint8_t cs8_xor;
+  unsigned long ok = 0;
+  const uint64_t start = osp3sim_now_ns();
+  for (unsigned long i = 0; i < c->count; i++) {
+    ok += osp3_log_checksum(&c->slots[i * SLOT_SIZE], SLOT_SIZE, &cs8_2s, &cs8_xor) == 0;
+  }
+  *ns = osp3sim_now_ns() - start;
+  *lines = c->count;
+  sink += ok;
+  return 0;
+}
+
+static int bench_checksum_test(const corpus* c, unsigned long* lines, uint64_t* ns) {
+  unsigned long ok = 0;
+  const uint64_t start = osp3sim_now_ns();
+  for (unsigned long i = 0; i < c->count; i++) {
+    ok += osp3_log_checksum_test(&c->slots[i * SLOT_SIZE], SLOT_SIZE, c->cs8_2s[i], c->cs8_xor[i]) == 0;
+  }
+  *ns = osp3sim_now_ns() - start;
+  *lines = c->count;
+  sink += ok;
+  return 0;
+}
+
+static int bench_read_line_mem(const corpus* c, unsigned long* lines, uint64_t* ns) {
+  unsigned char buf[SLOT_SIZE];
+  size_t transferred;
+  size_t discarded;
+  osp3_device* dev;
+  if ((dev = osp3_open_mem(c->stream, c->stream_len, packet_size)) == NULL) {
+    return -1;
+  }
+  *lines = 0;
+  const uint64_t start = osp3sim_now_ns();
+  while (osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, 0) == 0) {
+    (*lines)++;
+  }
+  *ns = osp3sim_now_ns() - start;
+  const int err = errno;
+  osp3_close(dev);
+  if (err != ENODATA) {
+    errno = err;
+    return -1;
+  }
+  return 0;
+}
+
+typedef struct pty_writer {
+  int fd;
+  const corpus* c;
+  int ret;
+} pty_writer;
+
+static void* pty_writer_run(void* arg) {
+  pty_writer* w = arg;
+  size_t off = 0;
+  w->ret = 0;
+  while (off < w->c->stream_len) {
+    size_t n = w->c->stream_len - off < packet_size ? w->c->stream_len - off : packet_size;
+    ssize_t written = write(w->fd, &w->c->stream[off], n);
+    if (written < 0) {
+      struct pollfd pfd = { .fd = w->fd, .events = POLLOUT };
+      if (errno == EINTR || ((errno == EAGAIN || errno == EWOULDBLOCK) && poll(&pfd, 1, PTY_STALL_MS) > 0)) {
+        continue;
+      }
+      // Failed, or the reader gave up.
+      w->ret = -1;
+      break;
+    }
+    off += (size_t) written;
+  }
+  return NULL;
+}
+
+static int bench_read_line_pty(const corpus* c, unsigned long* lines, uint64_t* ns) {
+  unsigned char buf[SLOT_SIZE];
+  size_t transferred;
+  size_t discarded;
+  osp3_device* dev = NULL;
+  pthread_t thread;
+  pty_writer w = { .fd = -1, .c = c };
+  const char* path;
+  int ret = -1;
+  if ((w.fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0 ||
+      grantpt(w.fd) < 0 || unlockpt(w.fd) < 0 || (path = ptsname(w.fd)) == NULL ||
+      fcntl(w.fd, F_SETFL, O_NONBLOCK) < 0 ||
+      (dev = osp3_open_path(path, 0)) == NULL) {
+    goto out;
+  }
+  if ((errno = pthread_create(&thread, NULL, pty_writer_run, &w)) != 0) {
+    goto out;
+  }
+  *lines = 0;
+  const uint64_t start = osp3sim_now_ns();
+  uint64_t end = start;
+  // The stream may end with a partial line, so stop when the pty goes quiet.
+  while (osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, PTY_DRAIN_MS) == 0) {
+    end = osp3sim_now_ns();
+    (*lines)++;
+  }
+  *ns = end - start;
+  ret = errno == ETIME ? 0 : -1;
+  pthread_join(thread, NULL);
+  if (w.ret < 0) {
+    ret = -1;
+  }
+out:
+  if (dev != NULL) {
+    osp3_close(dev);
+  }
+  if (w.fd >= 0) {
+    close(w.fd);
+  }
+  return ret;
+}
+
+static const bench benches[] = {
+  { "parse", bench_parse },
+  { "checksum", bench_checksum },
+  { "checksum_test", bench_checksum_test },
+  { "read_line_mem", bench_read_line_mem },
+  { "read_line_pty", bench_read_line_pty },
+};
+
+static int corpus_find(const char* name) {
+  for (int s = 0; s < CORPUS_COUNT; s++) {
+    if (!strcmp(name, corpus_names[s])) {
+      return s;
+    }
+  }
+  return -1;
+}
+
+static int bench_find(const char* name) {
+  for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+    if (!strcmp(name, benches[i].name)) {
+      return (int) i;
+    }
+  }
+  return -1;
+}
+
+// Repeat passes over the corpus until the minimum run time is reached.
+static int bench_run(const bench* b, const corpus* c, unsigned long* lines, uint64_t* ns) {
+  const uint64_t min_ns = min_ms * 1000000ull;
+  *lines = 0;
+  *ns = 0;
+  do {
+    unsigned long pass_lines;
+    uint64_t pass_ns;
+    if (b->fn(c, &pass_lines, &pass_ns) < 0) {
+      return -1;
+    }
+    *lines += pass_lines;
+    *ns += pass_ns;
+  } while (*ns < min_ns);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  corpus c;
+  int first = 1;
+  int ret = 0;
+
+  parse_args(argc, argv);
+  if ((corpus_filter != NULL && corpus_find(corpus_filter) < 0) || (bench_filter != NULL && bench_find(bench_filter) < 0)) {
+    fprintf(stderr, "Unknown corpus or benchmark\n");
+    print_usage(1);
+  }
+
+  if (json) {
+    printf("{\"lines\": %lu, \"packet_size\": %zu, \"results\": [", count, packet_size);
+  } else {
+    printf("%-8s %-16s %12s %14s\n", "corpus", "bench", "ns/line", "lines/s");
+  }
+  for (int s = 0; s < CORPUS_COUNT && ret == 0; s++) {
+    if (corpus_filter != NULL && strcmp(corpus_filter, corpus_names[s])) {
+      continue;
+    }
+    if (corpus_init(&c, (corpus_shape) s, count) < 0) {
+      perror("Failed to generate corpus");
+      corpus_destroy(&c);
+      ret = 1;
+      break;
+    }
+    for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+      unsigned long lines;
+      uint64_t ns;
+      if (bench_filter != NULL && strcmp(bench_filter, benches[i].name)) {
+        continue;
+      }
+      if (bench_run(&benches[i], &c, &lines, &ns) < 0) {
+        fprintf(stderr, "%s/%s: %s\n", corpus_names[s], benches[i].name, strerror(errno));
+        ret = 1;
+        break;
+      }
+      const double ns_per_line = lines > 0 ? (double) ns / (double) lines : 0;
+      const double lines_per_s = ns > 0 ? (double) lines * 1e9 / (double) ns : 0;
+      if (json) {
+        printf("%s\n  {\"corpus\": \"%s\", \"bench\": \"%s\", \"lines\": %lu, \"ns\": %llu, "
+               "\"ns_per_line\": %.2f, \"lines_per_s\": %.0f}",
+               first ? "" : ",", corpus_names[s], benches[i].name, lines, (unsigned long long) ns, ns_per_line,
+               lines_per_s);
+        first = 0;
+      } else {
+        printf("%-8s %-16s %12.2f %14.0f\n", corpus_names[s], benches[i].name, ns_per_line, lines_per_s);
+      }
+      fflush(stdout);
+    }
+    corpus_destroy(&c);
+  }
+  if (json) {
+    printf("\n]}\n");
+  }
+
+  return ret;
+}
@@ -52,6 +52,11 @@ extern "C" {
  */
 #define OSP3_INTERVAL_MS_DEFAULT 10
 
+/**
+ * Default time to listen at each baud rate in `osp3_open_path_probe`.
+ */
+#define OSP3_PROBE_TIMEOUT_MS_DEFAULT (2 * OSP3_INTERVAL_MS_MAX + 200)
+
 /**
  * Maximum serial packet size.
  */
@@ -119,6 +124,140 @@ typedef struct osp3_log_entry {
  */
 osp3_device* osp3_open_path(const char* path, unsigned int baud);
 
+/**
+ * Device settings detected by `osp3_open_path_probe`.
+ */
+typedef struct osp3_probe_info {
+  // The baud rate that the device is using.
+  unsigned int baud;
+  // The device's logging interval, from consecutive log entry timestamps.
+  unsigned int interval_ms;
+  // A read timeout for `osp3_read_line` derived from the interval and baud rate.
+  unsigned int timeout_ms;
+} osp3_probe_info;
+
+/**
+ * Open an OSP3 device, detecting its baud rate and logging interval.
+ *
+ * If nothing is received within `timeout_ms`, errno is set to ETIME.
+ * If data is received, but never valid log entries, errno is set to EPROTO.
+ *
+ * @param path The device path
+ * @param timeout_ms How long to listen at each baud rate (or 0 for `OSP3_PROBE_TIMEOUT_MS_DEFAULT`)
+ * @param info The detected settings
+ * @return A osp3_device handle, or NULL on failure
+ */
+osp3_device* osp3_open_path_probe(const char* path, unsigned int timeout_ms, osp3_probe_info* info);
+
+/**
+ * Open an in-memory device that serves data from a buffer instead of a serial port (e.g., for testing).
+ *
+ * Once the buffer is exhausted, `osp3_read_line` fails with errno ENODATA.
+ *
+ * @param buf The data to serve, which isn't copied and must remain valid until the device is closed
+ * @param len The data length
+ * @param packet_size The maximum bytes per read (or 0 for `OSP3_W_MAX_PACKET_SIZE`)
+ * @return A osp3_device handle, or NULL on failure
+ */
+osp3_device* osp3_open_mem(const void* buf, size_t len, size_t packet_size);
+
+/**
+ * Open a device that reads from an open file descriptor, e.g., standard input, a pipe, or a captured log file.
+ *
+ * At the end of the file, `osp3_read_line` fails with errno ENODATA.
+ * The file descriptor is not closed by `osp3_close`.
+ *
+ * @param fd The file descriptor
+ * @return A osp3_device handle, or NULL on failure
+ */
+osp3_device* osp3_open_fd(int fd);
+
+/**
+ * Open a device that follows a growing file like `tail -F`, including truncation and rotation.
+ *
+ * Only supported on Linux (errno is set to ENOTSUP elsewhere).
+ *
+ * @param path The file path, which must exist
+ * @param seek_end Non-zero to start at the end of the file (only new data is read), or 0 to start at the beginning
+ * @return A osp3_device handle, or NULL on failure
+ */
+osp3_device* osp3_open_follow(const char* path, int seek_end);
+
+/**
+ * The alignment required of caller-provided device storage (a cache line).
+ */
+#define OSP3_DEVICE_ALIGN 64
+
+/**
+ * The buffer size allocated by `osp3_open_fd` and `osp3_open_follow`.
+ */
+#define OSP3_FD_BUF_SIZE_DEFAULT (64 * 1024)
+
+/**
+ * The buffer size allocated by `osp3_set_coalesce`.
+ */
+#define OSP3_COALESCE_BUF_SIZE_DEFAULT 4096
+
+/**
+ * Buffers to reserve in caller-provided device storage, so a device never allocates memory.
+ * A size of 0 reserves no buffer.
+ */
+typedef struct osp3_buffer_opts {
+  // For `osp3_open_fd_into`, which requires one.
+  size_t fd_buf_size;
+  // For `osp3_set_coalesce`, which allocates a buffer of `OSP3_COALESCE_BUF_SIZE_DEFAULT` bytes if none is reserved.
+  size_t coalesce_buf_size;
+} osp3_buffer_opts;
+
+/**
+ * Get the storage size required for a device opened with an `osp3_open_*_into` function.
+ *
+ * @param opts The buffers to reserve, or NULL for none
+ * @return The storage size in bytes
+ */
+size_t osp3_device_size(const osp3_buffer_opts* opts);
+
+/**
+ * Like `osp3_open_path`, but in caller-provided storage, so the device never allocates memory.
+ *
+ * Storage must be aligned to `OSP3_DEVICE_ALIGN` and at least `osp3_device_size(opts)` bytes (errno is set to EINVAL
+ * otherwise), and isn't freed by `osp3_close`.
+ *
+ * @param storage The storage for the device
+ * @param storage_size The storage size in bytes
+ * @param opts The buffers to reserve, or NULL for none
+ * @param path The device path
+ * @param baud The baud rate (or 0 for default)
+ * @return A osp3_device handle (at the start of `storage`), or NULL on failure
+ */
+osp3_device* osp3_open_path_into(void* storage, size_t storage_size, const osp3_buffer_opts* opts, const char* path,
+                                 unsigned int baud);
+
+/**
+ * Like `osp3_open_fd`, but in caller-provided storage (see `osp3_open_path_into`).
+ *
+ * @param storage The storage for the device
+ * @param storage_size The storage size in bytes
+ * @param opts The buffers to reserve, which must include `fd_buf_size`
+ * @param fd The file descriptor
+ * @return A osp3_device handle (at the start of `storage`), or NULL on failure
+ */
+osp3_device* osp3_open_fd_into(void* storage, size_t storage_size, const osp3_buffer_opts* opts, int fd);
+
+/**
+ * Like `osp3_open_mem`, but in caller-provided storage (see `osp3_open_path_into`).
+ *
+ * @param storage The storage for the device
+ * @param storage_size The storage size in bytes
+ * @param opts The buffers to reserve, or NULL for none
+ * @param buf The data to serve
+ * @param len The data length
+ * @param packet_size The maximum bytes per read (or 0 for `OSP3_W_MAX_PACKET_SIZE`)
+ * @return A osp3_device handle (at the start of `storage`), or NULL on failure
+ */
+osp3_device* osp3_open_mem_into(void* storage, size_t storage_size, const osp3_buffer_opts* opts, const void* buf,
+                                size_t len, size_t packet_size);
+
 /**
  * Close an OSP3 device handle.
  *
@@ -135,6 +274,160 @@ int osp3_close(osp3_device* dev);
  */
 int osp3_flush(osp3_device* dev);
 
+/**
+ * Get a device's underlying file descriptor, e.g., to wait on several devices with `poll`.
+ *
+ * Don't mix direct reads with `osp3_read*` functions unless the device has been flushed.
+ *
+ * @param dev An open device
+ * @return The file descriptor, or -1 on error (errno is set to ENOTSUP for devices without one, e.g., in-memory)
+ */
+int osp3_get_fd(const osp3_device* dev);
+
+/**
+ * How `osp3_read_line` waits for lines.
+ */
+typedef enum osp3_schedule {
+  // Wait for data as it arrives (the default).
+  OSP3_SCHEDULE_BLOCK,
+  // Sleep until each line is expected to be complete, so it's read with one wakeup.
+  OSP3_SCHEDULE_PREDICT,
+} osp3_schedule;
+
+/**
+ * Set how `osp3_read_line` waits for lines.
+ *
+ * @param dev An open device
+ * @param schedule The schedule
+ * @return 0 on success, -1 on error
+ */
+int osp3_set_schedule(osp3_device* dev, osp3_schedule schedule);
+
+/**
+ * The maximum latency for `osp3_set_coalesce`.
+ */
+#define OSP3_COALESCE_MS_MAX 500
+
+/**
+ * Coalesce reads into batches, trading latency for fewer wakeups.
+ *
+ * Takes precedence over `osp3_set_schedule`.
+ *
+ * @param dev An open device
+ * @param max_latency_ms The maximum added latency, up to `OSP3_COALESCE_MS_MAX`, or 0 to disable coalescing
+ * @return 0 on success, -1 on error
+ */
+int osp3_set_coalesce(osp3_device* dev, unsigned int max_latency_ms);
+
+/**
+ * Clocks for line timestamps.
+ */
+typedef enum osp3_clock {
+  // No timestamps (the default).
+  OSP3_CLOCK_NONE,
+  // CLOCK_MONOTONIC.
+  OSP3_CLOCK_MONOTONIC,
+  // CLOCK_REALTIME, e.g., to correlate with other hosts' logs.
+  OSP3_CLOCK_REALTIME,
+  // CLOCK_MONOTONIC_RAW, which isn't slewed by NTP, e.g., to measure the device's clock drift.
+  OSP3_CLOCK_MONOTONIC_RAW,
+  // CLOCK_BOOTTIME, which includes time suspended (Linux only).
+  OSP3_CLOCK_BOOTTIME,
+} osp3_clock;
+
+/**
+ * Set the clock for line timestamps (see `osp3_get_line_time`).
+ *
+ * Clocks not supported by the platform fail with errno ENOTSUP.
+ *
+ * @param dev An open device
+ * @param clock The clock, or `OSP3_CLOCK_NONE` to disable timestamps
+ * @return 0 on success, -1 on error
+ */
+int osp3_set_clock(osp3_device* dev, osp3_clock clock);
+
+/**
+ * Get when the line most recently read with `osp3_read_line` was received.
+ *
+ * @param dev An open device
+ * @param ns The time in nanoseconds, per the clock set with `osp3_set_clock` (errno is set to EINVAL if none is set, or
+ *           to ENODATA if no line has been read since it was set)
+ * @return 0 on success, -1 on error
+ */
+int osp3_get_line_time(const osp3_device* dev, uint64_t* ns);
+
+/**
+ * Don't flush data received before opening (which may be stale).
+ */
+#define OSP3_OPEN_NO_FLUSH 0x1
+
+/**
+ * Discard data through the first newline after opening or flushing, so `osp3_read_line` never returns a partial line.
+ */
+#define OSP3_OPEN_SKIP_PARTIAL 0x2
+
+/**
+ * Options for `osp3_open_ex`, initialized with `OSP3_OPEN_OPTS_INIT`.
+ * Zero values select the same behavior as `osp3_open_path`.
+ */
+typedef struct osp3_open_opts {
+  // Must be `sizeof(osp3_open_opts)`.
+  size_t size;
+  // The baud rate (or 0 for default).
+  unsigned int baud;
+  // `OSP3_OPEN_*` flags.
+  unsigned int flags;
+  // See `osp3_set_clock`.
+  osp3_clock clock;
+  // See `osp3_set_schedule`.
+  osp3_schedule schedule;
+  // See `osp3_set_coalesce`.
+  unsigned int coalesce_ms;
+  // Buffer sizes - only `coalesce_buf_size` applies, which sizes the buffer allocated (or reserved in `storage`).
+  osp3_buffer_opts buffers;
+  // Caller-provided storage, or NULL to allocate the device (see `osp3_open_path_into`).
+  void* storage;
+  size_t storage_size;
+} osp3_open_opts;
+
+#define OSP3_OPEN_OPTS_INIT { .size = sizeof(osp3_open_opts) }
+
+/**
+ * Open an OSP3 device, with options for buffering, timestamps, and latency.
+ *
+ * If `opts->size` includes fields this version doesn't support, errno is set to ENOTSUP.
+ *
+ * @param path The device path
+ * @param opts The options, or NULL for defaults
+ * @return A osp3_device handle, or NULL on failure
+ */
+osp3_device* osp3_open_ex(const char* path, const osp3_open_opts* opts);
+
+/**
+ * Real-time settings for the thread that reads a device.
+ */
+typedef struct osp3_realtime {
+  // The CPU to pin the calling thread to, or -1 to leave its affinity unchanged.
+  int cpu;
+  // The calling thread's SCHED_FIFO priority, or 0 to leave its scheduling policy unchanged.
+  int fifo_priority;
+  // If non-zero, lock the device's buffers (and part of the calling thread's stack) in memory.
+  int lock_memory;
+} osp3_realtime;
+
+/**
+ * Apply real-time settings to the calling thread, which should be the one that reads the device.
+ *
+ * Enable coalescing (if desired) first, so its buffer is locked too.
+ * Pinning and SCHED_FIFO are only supported on Linux (errno is set to ENOTSUP elsewhere).
+ * If not permitted, errno is set to EPERM or ENOMEM.
+ *
+ * @param dev An open device
+ * @param rt The settings
+ * @return 0 on success, -1 on error
+ */
+int osp3_set_realtime(osp3_device* dev, const osp3_realtime* rt);
+
 /**
  * Read from an OSP3.
  *
@@ -150,6 +443,15 @@ int osp3_flush(osp3_device* dev);
  */
 int osp3_read(osp3_device* dev, unsigned char* buf, size_t len, size_t* transferred, unsigned int timeout_ms);
 
+/**
+ * Wait for data to be available to read from an OSP3, without reading it.
+ *
+ * @param dev An open device
+ * @param timeout_ms A timeout in milliseconds (or 0 to wait indefinitely); errno is set to ETIME if it expires
+ * @return 0 on success, -1 on error
+ */
+int osp3_wait(const osp3_device* dev, unsigned int timeout_ms);
+
 /**
  * Read a complete line from an OSP3.
  *
@@ -163,15 +465,197 @@ int osp3_read(osp3_device* dev, unsigned char* buf, size_t len, size_t* transfer
  * If the final read captures data after a newline character, it is buffered separately.
  * Any following read (including from `osp3_read`) will first get data from this buffer before reading from the OSP3.
  *
+ * If the buffer fills before a newline character is found, errno is set to ENOBUFS and the rest of the line is left
+ * unread (see `osp3_read_line_resync`).
+ * If the data ends before a newline character is found, errno is set to ENODATA.
+ *
  * @param dev An open device
  * @param buf The destination buffer
  * @param len The destination buffer size
- * @param line_writte The number of bytes actually read
+ * @param transferred The number of bytes actually read
  * @param timeout_ms A timeout in milliseconds
  * @return 0 on success, -1 on error
  */
 int osp3_read_line(osp3_device* dev, unsigned char* buf, size_t len, size_t* transferred, unsigned int timeout_ms);
 
+/**
+ * Read a complete line from an OSP3, discarding lines that don't fit in the buffer (through their newline character).
+ *
+ * If a read fails while discarding, the next call continues discarding the same line.
+ *
+ * @param dev An open device
+ * @param buf The destination buffer
+ * @param len The destination buffer size
+ * @param transferred The number of bytes actually read
+ * @param discarded The number of bytes discarded from oversize lines
+ * @param timeout_ms A timeout in milliseconds
+ * @return 0 on success, -1 on error
+ */
+int osp3_read_line_resync(osp3_device* dev, unsigned char* buf, size_t len, size_t* transferred, size_t* discarded,
+                          unsigned int timeout_ms);
+
+/**
+ * Device I/O and error counters, since the device was opened.
+ */
+typedef struct osp3_stats {
+  // Bytes returned by device reads.
+  uint64_t bytes_read;
+  // Device read operations (system calls, for serial devices).
+  uint64_t reads;
+  // Reads that timed out.
+  uint64_t timeouts;
+  // Complete lines read by `osp3_read_line`.
+  uint64_t lines;
+  // Lines left incomplete by a read error (e.g., a timeout or the end of data) after some bytes were read.
+  uint64_t lines_partial;
+  // Lines that didn't fit in the caller's buffer (each counted once, however many reads it took).
+  uint64_t lines_oversize;
+  // Oversize lines discarded by `osp3_read_line_resync`, and their total bytes (also partial lines skipped after
+  // opening with `OSP3_OPEN_SKIP_PARTIAL`).
+  uint64_t resyncs;
+  uint64_t bytes_discarded;
+  // Failures reported by `osp3_log_verify`.
+  uint64_t parse_failures;
+  uint64_t checksum_failures;
+  // Valid entries whose timestamp skipped ahead by more than 1.5x the shortest interval seen, i.e., entries were lost.
+  uint64_t ms_gaps;
+  // Valid entries whose timestamp went backwards (e.g., the device restarted).
+  uint64_t ms_resets;
+  // Kernel serial driver error counts, only if `kernel_counters` is non-zero (Linux drivers that support TIOCGICOUNT).
+  // Hardware receive FIFO overruns and kernel buffer overruns (i.e., the reader isn't keeping up) drop bytes.
+  uint64_t overruns;
+  uint64_t buf_overruns;
+  uint64_t frame_errors;
+  uint64_t parity_errors;
+  // Failures reported by `osp3_log_verify` after the kernel counted overruns since the previous failure, i.e., likely due
+  // to dropped bytes - other failures are likely due to line noise.
+  uint64_t parse_failures_overrun;
+  uint64_t checksum_failures_overrun;
+  int kernel_counters;
+} osp3_stats;
+
+/**
+ * Get a device's I/O and error counters (from any thread).
+ *
+ * @param dev An open device
+ * @param stats The counters to populate
+ * @return 0 on success, -1 on error
+ */
+int osp3_get_stats(const osp3_device* dev, osp3_stats* stats);
+
+/**
+ * Line latency stages, measured when the library is built with `OSP3_LATENCY` enabled.
+ */
+typedef enum osp3_latency_stage {
+  // From reading a line's first byte to reading its newline character (line assembly).
+  OSP3_LATENCY_STAGE_ASSEMBLY,
+  // From line completion to `osp3_latency_mark` with `OSP3_LATENCY_MARK_PARSED`.
+  OSP3_LATENCY_STAGE_PARSE,
+  // From parsing (or line completion, if not marked) to `osp3_latency_mark` with `OSP3_LATENCY_MARK_DELIVERED`.
+  OSP3_LATENCY_STAGE_DELIVERY,
+  // From reading a line's first byte to delivery.
+  OSP3_LATENCY_STAGE_TOTAL,
+  OSP3_LATENCY_STAGE_COUNT
+} osp3_latency_stage;
+
+/**
+ * Consumer events for the most recent line read by `osp3_read_line` (or `osp3_read_line_resync`).
+ */
+typedef enum osp3_latency_mark_event {
+  OSP3_LATENCY_MARK_PARSED,
+  OSP3_LATENCY_MARK_DELIVERED,
+} osp3_latency_mark_event;
+
+/**
+ * Latency summary for a stage.
+ * Percentiles are accurate to within 1/16th (6.25%) of their value.
+ */
+typedef struct osp3_latency_stats {
+  uint64_t count;
+  uint64_t p50_ns;
+  uint64_t p99_ns;
+  uint64_t max_ns;
+} osp3_latency_stats;
+
+/**
+ * Record that the consumer finished parsing or delivering the most recent line (from the thread that reads lines).
+ *
+ * @param dev An open device
+ * @param event The event
+ * @return 0 on success, -1 on error (errno is set to ENOTSUP if latency instrumentation isn't compiled in)
+ */
+int osp3_latency_mark(osp3_device* dev, osp3_latency_mark_event event);
+
+/**
+ * Get a latency summary for a stage (from any thread).
+ *
+ * @param dev An open device
+ * @param stage The stage
+ * @param stats The summary to populate
+ * @return 0 on success, -1 on error (errno is set to ENOTSUP if latency instrumentation isn't compiled in)
+ */
+int osp3_latency_get(const osp3_device* dev, osp3_latency_stage stage, osp3_latency_stats* stats);
+
+/**
+ * Clear recorded latencies for all stages.
+ *
+ * @param dev An open device
+ * @return 0 on success, -1 on error (errno is set to ENOTSUP if latency instrumentation isn't compiled in)
+ */
+int osp3_latency_reset(osp3_device* dev);
+
+/**
+ * Whose resource usage `osp3_self_stats_get` reports.
+ */
+typedef enum osp3_self_scope {
+  // The whole process, including threads that have exited.
+  OSP3_SELF_PROCESS,
+  // Only the calling thread, e.g., the thread reading the device (Linux only).
+  OSP3_SELF_THREAD,
+} osp3_self_scope;
+
+/**
+ * The monitor's own resource usage, to quantify how much it perturbs the host it's measuring.
+ * Values are differences since `osp3_self_stats_reset`.
+ */
+typedef struct osp3_self_stats {
+  // Wall clock (CLOCK_MONOTONIC) time elapsed.
+  uint64_t elapsed_ns;
+  // CPU time (precise, from the scheduler where supported), and its user and system time breakdown (at a granularity
+  // that may be as coarse as a scheduler tick).
+  uint64_t cpu_ns;
+  uint64_t user_ns;
+  uint64_t system_ns;
+  // Voluntary context switches (i.e., blocking and later waking up), and involuntary ones (i.e., preemption).
+  uint64_t voluntary_switches;
+  uint64_t involuntary_switches;
+  // Complete lines read from the device, for normalizing per sample.
+  uint64_t lines;
+} osp3_self_stats;
+
+/**
+ * Start measuring the monitor's resource usage from now.
+ *
+ * With `OSP3_SELF_THREAD`, call this and `osp3_self_stats_get` from the same thread, usually the one that reads the
+ * device - the reading thread is the only one that wakes for each sample.
+ *
+ * @param dev An open device
+ * @param scope The process or the calling thread (errno is set to ENOTSUP if per-thread usage isn't available)
+ * @return 0 on success, -1 on error
+ */
+int osp3_self_stats_reset(osp3_device* dev, osp3_self_scope scope);
+
+/**
+ * Get the monitor's resource usage since `osp3_self_stats_reset`.
+ *
+ * Sampling resource usage costs system calls, so avoid calling this for every line.
+ *
+ * @param dev An open device
+ * @param stats The usage to populate
+ * @return 0 on success, -1 on error (errno is set to EINVAL if `osp3_self_stats_reset` hasn't been called)
+ */
+int osp3_self_stats_get(const osp3_device* dev, osp3_self_stats* stats);
+
 /**
  * Perform a checksum on a log entry.
  *
@@ -204,6 +688,31 @@ int osp3_log_checksum_test(const char* log, size_t log_sz, uint8_t cs8_2s, uint8
  */
 int osp3_log_parse(const char* log, size_t log_sz, osp3_log_entry* log_entry);
 
+/**
+ * Parse a log entry and verify its checksum, recording the outcome in a device's counters (see `osp3_get_stats`).
+ *
+ * Must be called from the thread that reads from the device.
+ *
+ * @param dev The device the log entry was read from (or NULL to not record the outcome)
+ * @param log The log entry buffer - doesn't require trailing '\r' and/or '\n', but must null-terminated.
+ * @param log_sz Must be `>= OSP3_LOG_PROTOCOL_SIZE - 1`
+ * @param log_entry The struct to be populated
+ * @return 0 if valid, 1 if not all fields were parsed, 2 on checksum mismatch, -1 on error
+ */
+int osp3_log_verify(osp3_device* dev, const char* log, size_t log_sz, osp3_log_entry* log_entry);
+
+/**
+ * Format a log entry in the device's wire format.
+ *
+ * Exactly `OSP3_LOG_PROTOCOL_SIZE` bytes are written, including the trailing "\r\n" but no null terminator.
+ * Checksums are computed from the formatted fields - the entry's checksum fields are ignored.
+ *
+ * @param log_entry The log entry
+ * @param log The destination buffer - must have room for at least `OSP3_LOG_PROTOCOL_SIZE` bytes
+ * @return 0 on success, -1 on error (errno is set to ERANGE if a field value is too large for the format)
+ */
+int osp3_log_format(const osp3_log_entry* log_entry, char* log);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,230 @@
+/**
+ * Simulate an ODROID Smart Power 3 on a pseudo-terminal.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <osp3.h>
+#include "osp3sim.h"
+
+#define BURST_LEN_DEFAULT 256
+#define DELAY_MS_DEFAULT 50
+
+static osp3sim_config cfg;
+static int use_stdout = 0;
+static osp3sim* sim = NULL;
+
+enum long_only_options {
+  OPT_DROP = 256,
+  OPT_FLIP,
+  OPT_DUP,
+  OPT_TRUNCATE,
+  OPT_BURST,
+  OPT_BURST_LEN,
+  OPT_SPLIT,
+  OPT_DELAY,
+  OPT_DELAY_MS,
+};
+
+static const char short_options[] = "hi:b:s:n:w:S:";
+static const struct option long_options[] = {
+  {"help",        no_argument,       NULL, 'h'},
+  {"interval",    required_argument, NULL, 'i'},
+  {"baud",        required_argument, NULL, 'b'},
+  {"packet-size", required_argument, NULL, 's'},
+  {"num",         required_argument, NULL, 'n'},
+  {"waveform",    required_argument, NULL, 'w'},
+  {"seed",        required_argument, NULL, 'S'},
+  // Long-only options.
+  {"stdout",      no_argument,       &use_stdout, 1},
+  {"baud-check",  no_argument,       &cfg.baud_check, 1},
+  {"drop",        required_argument, NULL, OPT_DROP},
+  {"flip",        required_argument, NULL, OPT_FLIP},
+  {"dup",         required_argument, NULL, OPT_DUP},
+  {"truncate",    required_argument, NULL, OPT_TRUNCATE},
+  {"burst",       required_argument, NULL, OPT_BURST},
+  {"burst-len",   required_argument, NULL, OPT_BURST_LEN},
+  {"split",       required_argument, NULL, OPT_SPLIT},
+  {"delay",       required_argument, NULL, OPT_DELAY},
+  {"delay-ms",    required_argument, NULL, OPT_DELAY_MS},
+  {0, 0, 0, 0}
+};
+
+static const char* const waveform_names[] = {
+  [OSP3SIM_WAVEFORM_CONSTANT] = "constant",
+  [OSP3SIM_WAVEFORM_SINE] = "sine",
+  [OSP3SIM_WAVEFORM_SQUARE] = "square",
+  [OSP3SIM_WAVEFORM_RANDOM] = "random",
+  [OSP3SIM_WAVEFORM_IDLE] = "idle",
+};
+
+__attribute__ ((noreturn))
+static void print_usage(int exit_code) {
+  fprintf(exit_code ? stderr : stdout,
+          "Simulate an ODROID Smart Power 3 on a pseudo-terminal.\n"
+          "The pty device path is printed to standard output, then log entries are written until stopped.\n\n"
+          "Usage: osp3-sim [OPTION]...\n"
+          "Options:\n"
+          "  -h, --help               Print this message and exit\n"
+          "  -i, --interval=MS        Logging interval in milliseconds (default: %u)\n"
+          "                           Use 0 to write lines back-to-back\n"
+          "  -b, --baud=RATE          Pace writes to match a baud rate (default: unpaced)\n"
+          "  -s, --packet-size=BYTES  Maximum bytes per write (default: %u)\n"
+          "  -n, --num=N              Stop after N log entries\n"
+          "  -w, --waveform=NAME      One of: constant, sine, square, random, idle (default: sine)\n"
+          "  -S, --seed=N             Random number generator seed (default: 1)\n"
+          "  --stdout                 Write to standard output instead of a pty\n"
+          "  --baud-check             Garble output while the pty's baud rate differs from --baud\n"
+          "Fault injection options (rates are in parts per million):\n"
+          "  --drop=PPM               Drop bytes\n"
+          "  --flip=PPM               Flip a random bit in bytes\n"
+          "  --dup=PPM                Duplicate bytes\n"
+          "  --truncate=PPM           Cut lines short (including the newline)\n"
+          "  --burst=PPM              Insert noise bursts into lines\n"
+          "  --burst-len=BYTES        Noise burst length (default: %u)\n"
+          "  --split=PPM              Split packets into shorter writes\n"
+          "  --delay=PPM              Stall before writing packets\n"
+          "  --delay-ms=MS            Stall duration (default: %u)\n",
+          OSP3_INTERVAL_MS_DEFAULT, OSP3_W_MAX_PACKET_SIZE, BURST_LEN_DEFAULT, DELAY_MS_DEFAULT);
+  exit(exit_code);
+}
+
+static osp3sim_waveform parse_waveform(const char* name) {
+  for (size_t i = 0; i < sizeof(waveform_names) / sizeof(waveform_names[0]); i++) {
+    if (!strcmp(name, waveform_names[i])) {
+      return (osp3sim_waveform) i;
+    }
+  }
+  fprintf(stderr, "Unknown waveform: %s\n", name);
+  print_usage(1);
+}
+
+static void parse_args(int argc, char** argv) {
+  int c;
+  while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+    switch (c) {
+      case 'h':
+        print_usage(0);
+        break;
+      case 'i':
+        cfg.interval_ms = (unsigned int) atoi(optarg);
+        break;
+      case 'b':
+        cfg.baud = (unsigned int) atoi(optarg);
+        break;
+      case 's':
+        cfg.packet_size = (size_t) atoi(optarg);
+        break;
+      case 'n':
+        cfg.count = strtoul(optarg, NULL, 0);
+        break;
+      case 'w':
+        cfg.waveform = parse_waveform(optarg);
+        break;
+      case 'S':
+        cfg.seed = (uint32_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_DROP:
+        cfg.faults.drop_ppm = (uint32_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_FLIP:
+        cfg.faults.flip_ppm = (uint32_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_DUP:
+        cfg.faults.dup_ppm = (uint32_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_TRUNCATE:
+        cfg.faults.truncate_ppm = (uint32_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_BURST:
+        cfg.faults.burst_ppm = (uint32_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_BURST_LEN:
+        cfg.faults.burst_len = (size_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_SPLIT:
+        cfg.faults.split_ppm = (uint32_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_DELAY:
+        cfg.faults.delay_ppm = (uint32_t) strtoul(optarg, NULL, 0);
+        break;
+      case OPT_DELAY_MS:
+        cfg.faults.delay_ms = (unsigned int) atoi(optarg);
+        break;
+      case 0:
+        // Long-only option.
+        break;
+      case '?':
+      default:
+        print_usage(1);
+        break;
+    }
+  }
+}
+
+static void shandle(int sig) {
+  switch (sig) {
+    case SIGTERM:
+    case SIGINT:
+#ifdef SIGQUIT
+    case SIGQUIT:
+#endif
+#ifdef SIGHUP
+    case SIGHUP:
+#endif
+      if (sim != NULL) {
+        osp3sim_stop(sim);
+      }
+    default:
+      break;
+  }
+}
+
+int main(int argc, char** argv) {
+  int ret = 0;
+
+  osp3sim_config_init(&cfg);
+  cfg.faults.burst_len = BURST_LEN_DEFAULT;
+  cfg.faults.delay_ms = DELAY_MS_DEFAULT;
+  parse_args(argc, argv);
+
+  signal(SIGINT, shandle);
+  signal(SIGTERM, shandle);
+  // Readers come and go - don't die when writing to a closed pipe.
+  signal(SIGPIPE, SIG_IGN);
+
+  if (use_stdout) {
+    sim = osp3sim_open_fd(&cfg, STDOUT_FILENO);
+  } else if ((sim = osp3sim_open(&cfg)) != NULL) {
+    printf("%s\n", osp3sim_path(sim));
+    fflush(stdout);
+  }
+  if (sim == NULL) {
+    perror("Failed to create simulator");
+    return 1;
+  }
+
+  if (osp3sim_run(sim) < 0) {
+    perror("osp3sim_run");
+    ret = 1;
+  }
+
+  unsigned long faulted;
+  unsigned long intact = osp3sim_lines_intact(sim, &faulted);
+  if (faulted > 0) {
+    fprintf(stderr, "Lines written: %lu intact, %lu faulted\n", intact, faulted);
+  }
+
+  if (osp3sim_close(sim)) {
+    perror("Failed to close simulator");
+  }
+
+  return ret;
+}
@@ -0,0 +1,556 @@
+/**
+ * A simulated ODROID Smart Power 3 (OSP3) for testing and benchmarking.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+// For posix_openpt, grantpt, unlockpt, ptsname, and clock_nanosleep.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <osp3.h>
+#include "osp3sim.h"
+
+// Number of recent line write times to remember.
+#define LINE_TIMES_LEN 1024
+
+// Serial framing: 1 start bit + 8 data bits + 1 stop bit.
+#define BITS_PER_BYTE 10
+
+// How often a blocked writer checks for a stop request.
+#define STOP_POLL_MS 100
+
+#define PATH_LEN_MAX 128
+
+struct osp3sim {
+  osp3sim_config cfg;
+  osp3sim_gen gen;
+  int fd;
+  int fd_slave;
+  int fd_owned;
+  char path[PATH_LEN_MAX];
+  pthread_t thread;
+  int thread_started;
+  int thread_ret;
+  atomic_int stop;
+  atomic_ulong lines_written;
+  atomic_ulong lines_faulted;
+  uint32_t fault_rng;
+  _Atomic uint64_t line_times[LINE_TIMES_LEN];
+};
+
+void osp3sim_config_init(osp3sim_config* cfg) {
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->interval_ms = OSP3_INTERVAL_MS_DEFAULT;
+  cfg->packet_size = OSP3_W_MAX_PACKET_SIZE;
+  cfg->waveform = OSP3SIM_WAVEFORM_SINE;
+  cfg->seed = 1;
+}
+
+uint32_t osp3sim_rand(uint32_t* state) {
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+uint64_t osp3sim_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void sleep_until_ns(uint64_t ns) {
+#ifdef __APPLE__
+  // No clock_nanosleep, so settle for a relative sleep.
+  uint64_t now = osp3sim_now_ns();
+  if (ns > now) {
+    struct timespec ts = {
+      .tv_sec = (time_t) ((ns - now) / 1000000000ull),
+      .tv_nsec = (long) ((ns - now) % 1000000000ull),
+    };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR);
+  }
+#else
+  struct timespec ts = {
+    .tv_sec = (time_t) (ns / 1000000000ull),
+    .tv_nsec = (long) (ns % 1000000000ull),
+  };
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+#endif
+}
+
+void osp3sim_gen_init(osp3sim_gen* gen, const osp3sim_config* cfg) {
+  gen->waveform = cfg->waveform;
+  gen->ms = cfg->ms_start;
+  gen->ms_step = cfg->interval_ms > 0 ? cfg->interval_ms : OSP3_INTERVAL_MS_MIN;
+  gen->rng = cfg->seed != 0 ? cfg->seed : 1;
+  gen->walk_mA = 800;
+}
+
+// Uniformly distributed noise in [-amplitude, amplitude].
+static int noise(osp3sim_gen* gen, unsigned int amplitude) {
+  return (int) (osp3sim_rand(&gen->rng) % (2 * amplitude + 1)) - (int) amplitude;
+}
+
+static unsigned int clamp(int val, unsigned int max) {
+  return val < 0 ? 0 : ((unsigned int) val > max ? max : (unsigned int) val);
+}
+
+static unsigned int load_mA(osp3sim_gen* gen) {
+  const double t = (double) gen->ms / 1000.0;
+  double s;
+  switch (gen->waveform) {
+  case OSP3SIM_WAVEFORM_CONSTANT:
+    return 800;
+  case OSP3SIM_WAVEFORM_SINE:
+    // 4 second period.
+    s = sin(2 * M_PI * t / 4.0);
+    return (unsigned int) (800.0 + 600.0 * s);
+  case OSP3SIM_WAVEFORM_SQUARE:
+    // 1 second phases.
+    return (gen->ms / 1000) % 2 ? 1500 : 300;
+  case OSP3SIM_WAVEFORM_RANDOM:
+    gen->walk_mA = clamp((int) gen->walk_mA + noise(gen, 50), 2500);
+    if (gen->walk_mA < 100) {
+      gen->walk_mA = 100;
+    }
+    return gen->walk_mA;
+  case OSP3SIM_WAVEFORM_IDLE:
+  default:
+    break;
+  }
+  return 0;
+}
+
+void osp3sim_gen_next(osp3sim_gen* gen, osp3_log_entry* entry) {
+  memset(entry, 0, sizeof(*entry));
+  entry->ms = gen->ms;
+  // Roughly a 15 V barrel jack supply.
+  entry->mV_in = clamp(15300 + noise(gen, 20), 99999);
+  if (gen->waveform != OSP3SIM_WAVEFORM_IDLE) {
+    const unsigned int load = load_mA(gen);
+    // Channel 0: a 5 V board that droops slightly under load.
+    entry->onoff_0 = 1;
+    entry->mV_0 = clamp(5100 - (int) (load / 50) + noise(gen, 5), 99999);
+    entry->mA_0 = clamp((int) load + noise(gen, 10), 9999);
+    entry->mW_0 = clamp((int) (entry->mV_0 * entry->mA_0 / 1000), 99999);
+    // Channel 1: a lightly loaded 12 V peripheral.
+    entry->onoff_1 = 1;
+    entry->mV_1 = clamp(12000 + noise(gen, 10), 99999);
+    entry->mA_1 = clamp(150 + noise(gen, 5), 9999);
+    entry->mW_1 = clamp((int) (entry->mV_1 * entry->mA_1 / 1000), 99999);
+    // Input: outputs at ~90% efficiency plus the device's own draw.
+    entry->onoff_in = 1;
+    entry->mW_in = clamp((int) ((entry->mW_0 + entry->mW_1) * 10 / 9 + 350), 99999);
+    entry->mA_in = clamp((int) (entry->mW_in * 1000 / entry->mV_in), 9999);
+  }
+  gen->ms += gen->ms_step;
+}
+
+static int chance(uint32_t* rng, uint32_t ppm) {
+  return ppm > 0 && osp3sim_rand(rng) % 1000000 < ppm;
+}
+
+int osp3sim_faults_apply(const osp3sim_faults* faults, uint32_t* rng, const char* line, size_t len, char* out,
+                         size_t* out_len) {
+  int faulted = 0;
+  size_t burst_pos = len + 1;
+  size_t n = 0;
+  if (chance(rng, faults->truncate_ppm) && len > 0) {
+    len = osp3sim_rand(rng) % len;
+    faulted = 1;
+  }
+  if (chance(rng, faults->burst_ppm) && faults->burst_len > 0 && len > 0) {
+    // Strictly within the line, so the line itself is always damaged.
+    burst_pos = osp3sim_rand(rng) % len;
+    faulted = 1;
+  }
+  for (size_t i = 0; i <= len; i++) {
+    if (i == burst_pos) {
+      const size_t burst_len = faults->burst_len < OSP3SIM_BURST_LEN_MAX ? faults->burst_len : OSP3SIM_BURST_LEN_MAX;
+      for (size_t j = 0; j < burst_len; j++) {
+        out[n++] = (char) (osp3sim_rand(rng) & 0xFF);
+      }
+    }
+    if (i == len) {
+      break;
+    }
+    if (chance(rng, faults->drop_ppm)) {
+      faulted = 1;
+      continue;
+    }
+    char c = line[i];
+    if (chance(rng, faults->flip_ppm)) {
+      c = (char) ((unsigned char) c ^ (1u << (osp3sim_rand(rng) % 8)));
+      faulted = 1;
+    }
+    out[n++] = c;
+    if (chance(rng, faults->dup_ppm)) {
+      out[n++] = c;
+      faulted = 1;
+    }
+  }
+  *out_len = n;
+  return faulted;
+}
+
+void osp3sim_recovery_init(osp3sim_recovery* rec) {
+  memset(rec, 0, sizeof(*rec));
+}
+
+void osp3sim_recovery_record(osp3sim_recovery* rec, int good, uint64_t now_ns) {
+  if (!good) {
+    if (rec->run++ == 0) {
+      rec->run_start_ns = now_ns;
+    }
+    rec->samples_bad++;
+    return;
+  }
+  if (rec->run > 0) {
+    const uint64_t ns = now_ns - rec->run_start_ns;
+    rec->resyncs++;
+    rec->resync_ns_total += ns;
+    if (ns > rec->resync_ns_max) {
+      rec->resync_ns_max = ns;
+    }
+    if (rec->run > rec->resync_run_max) {
+      rec->resync_run_max = rec->run;
+    }
+    rec->run = 0;
+  }
+  rec->samples_good++;
+}
+
+void osp3sim_recovery_finish(osp3sim_recovery* rec, const osp3sim* sim) {
+  rec->lines_intact = osp3sim_lines_intact(sim, &rec->lines_faulted);
+}
+
+double osp3sim_recovery_rate(const osp3sim_recovery* rec) {
+  return rec->lines_intact > 0 ? (double) rec->samples_good / (double) rec->lines_intact : 1.0;
+}
+
+static osp3sim* sim_alloc(const osp3sim_config* cfg) {
+  osp3sim* sim;
+  if ((sim = calloc(1, sizeof(osp3sim))) == NULL) {
+    return NULL;
+  }
+  if (cfg == NULL) {
+    osp3sim_config_init(&sim->cfg);
+  } else {
+    sim->cfg = *cfg;
+  }
+  if (sim->cfg.packet_size == 0) {
+    sim->cfg.packet_size = OSP3_W_MAX_PACKET_SIZE;
+  }
+  osp3sim_gen_init(&sim->gen, &sim->cfg);
+  // An independent stream, so enabling faults doesn't change the generated entries.
+  sim->fault_rng = ~sim->gen.rng != 0 ? ~sim->gen.rng : 1;
+  sim->fd = -1;
+  sim->fd_slave = -1;
+  atomic_init(&sim->stop, 0);
+  atomic_init(&sim->lines_written, 0);
+  atomic_init(&sim->lines_faulted, 0);
+  return sim;
+}
+
+static int pty_open(osp3sim* sim) {
+  const char* name;
+  struct termios t;
+  if ((sim->fd = posix_openpt(O_RDWR | O_NOCTTY)) < 0) {
+    return -1;
+  }
+  if (grantpt(sim->fd) < 0 || unlockpt(sim->fd) < 0 || (name = ptsname(sim->fd)) == NULL) {
+    return -1;
+  }
+  if (strlen(name) >= sizeof(sim->path)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  strcpy(sim->path, name);
+  // Holding the slave open keeps the pty usable while readers come and go.
+  // Raw mode prevents line discipline translations (e.g., '\r' to '\n') before a reader configures the port.
+  if ((sim->fd_slave = open(sim->path, O_RDWR | O_NOCTTY | O_NONBLOCK)) < 0 || tcgetattr(sim->fd_slave, &t) < 0) {
+    return -1;
+  }
+  cfmakeraw(&t);
+  if (tcsetattr(sim->fd_slave, TCSANOW, &t) < 0) {
+    return -1;
+  }
+  // Writes must not block indefinitely, or we couldn't respond to stop requests.
+  return fcntl(sim->fd, F_SETFL, fcntl(sim->fd, F_GETFL) | O_NONBLOCK);
+}
+
+osp3sim* osp3sim_open(const osp3sim_config* cfg) {
+  osp3sim* sim;
+  if ((sim = sim_alloc(cfg)) == NULL) {
+    return NULL;
+  }
+  sim->fd_owned = 1;
+  if (pty_open(sim) < 0) {
+    int err = errno;
+    osp3sim_close(sim);
+    errno = err;
+    return NULL;
+  }
+  return sim;
+}
+
+osp3sim* osp3sim_open_fd(const osp3sim_config* cfg, int fd) {
+  osp3sim* sim;
+  if (fd < 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((sim = sim_alloc(cfg)) == NULL) {
+    return NULL;
+  }
+  sim->fd = fd;
+  return sim;
+}
+
+const char* osp3sim_path(const osp3sim* sim) {
+  return sim->fd_owned ? sim->path : NULL;
+}
+
+static int write_all(osp3sim* sim, const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(sim->fd, buf, len);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return -1;
+      }
+      // The reader isn't keeping up - wait for space, but remain responsive to stop requests.
+      struct pollfd pfd = { .fd = sim->fd, .events = POLLOUT };
+      if (atomic_load(&sim->stop) || (poll(&pfd, 1, STOP_POLL_MS) < 0 && errno != EINTR)) {
+        return atomic_load(&sim->stop) ? 0 : -1;
+      }
+      continue;
+    }
+    buf += written;
+    len -= (size_t) written;
+  }
+  return 0;
+}
+
+static speed_t baud_to_speed(unsigned int baud) {
+  switch (baud) {
+    case 9600:
+      return B9600;
+    case 19200:
+      return B19200;
+    case 38400:
+      return B38400;
+    case 57600:
+      return B57600;
+    case 115200:
+      return B115200;
+    case 230400:
+      return B230400;
+#ifdef B460800
+    case 460800:
+      return B460800;
+#endif
+#ifdef B500000
+    case 500000:
+      return B500000;
+#endif
+#ifdef B576000
+    case 576000:
+      return B576000;
+#endif
+#ifdef B921600
+    case 921600:
+      return B921600;
+#endif
+    default:
+      return B0;
+  }
+}
+
+// Whether the reader's baud rate differs from the simulated device's.
+static int baud_mismatch(const osp3sim* sim) {
+  struct termios t;
+  if (!sim->cfg.baud_check || sim->fd_slave < 0 || tcgetattr(sim->fd_slave, &t) < 0) {
+    return 0;
+  }
+  return cfgetispeed(&t) != baud_to_speed(sim->cfg.baud);
+}
+
+// Write a line in packets, each available only after its bytes would have been clocked out at the baud rate.
+static int write_line(osp3sim* sim, const char* line, size_t len, uint64_t* t_next) {
+  const uint64_t byte_ns = sim->cfg.baud > 0 ? BITS_PER_BYTE * 1000000000ull / sim->cfg.baud : 0;
+  size_t off = 0;
+  while (off < len && !atomic_load(&sim->stop)) {
+    size_t n = len - off < sim->cfg.packet_size ? len - off : sim->cfg.packet_size;
+    if (chance(&sim->fault_rng, sim->cfg.faults.split_ppm)) {
+      n = 1 + osp3sim_rand(&sim->fault_rng) % n;
+    }
+    if (chance(&sim->fault_rng, sim->cfg.faults.delay_ppm)) {
+      const uint64_t now = osp3sim_now_ns();
+      *t_next = (*t_next > now ? *t_next : now) + sim->cfg.faults.delay_ms * 1000000ull;
+      sleep_until_ns(*t_next);
+    }
+    if (byte_ns > 0) {
+      *t_next += n * byte_ns;
+      sleep_until_ns(*t_next);
+    }
+    if (baud_mismatch(sim)) {
+      // Framing is lost, so the reader gets the wrong bytes.
+      char garbled[OSP3_W_MAX_PACKET_SIZE];
+      const size_t g = n < sizeof(garbled) ? n : sizeof(garbled);
+      for (size_t i = 0; i < g; i++) {
+        garbled[i] = (char) osp3sim_rand(&sim->fault_rng);
+      }
+      if (write_all(sim, garbled, g) < 0) {
+        return -1;
+      }
+    } else if (write_all(sim, &line[off], n) < 0) {
+      return -1;
+    }
+    off += n;
+  }
+  return 0;
+}
+
+int osp3sim_run(osp3sim* sim) {
+  char line[OSP3_LOG_PROTOCOL_SIZE];
+  char faulty[OSP3SIM_FAULTS_OUT_MAX];
+  osp3_log_entry entry;
+  const uint64_t interval_ns = sim->cfg.interval_ms * 1000000ull;
+  const uint64_t t0 = osp3sim_now_ns();
+  uint64_t t_next = t0;
+  for (unsigned long i = 0; !atomic_load(&sim->stop) && (sim->cfg.count == 0 || i < sim->cfg.count); i++) {
+    osp3sim_gen_next(&sim->gen, &entry);
+    if (osp3_log_format(&entry, line) < 0) {
+      return -1;
+    }
+    if (interval_ns > 0) {
+      // The device starts writing a line at each interval, unless it's still busy writing the previous line.
+      const uint64_t t_line = t0 + i * interval_ns;
+      if (t_line > t_next) {
+        t_next = t_line;
+      }
+      sleep_until_ns(t_next);
+    }
+    size_t len = OSP3_LOG_PROTOCOL_SIZE;
+    const char* out = line;
+    if (osp3sim_faults_apply(&sim->cfg.faults, &sim->fault_rng, line, len, faulty, &len)) {
+      out = faulty;
+      atomic_fetch_add(&sim->lines_faulted, 1);
+    }
+    if (write_line(sim, out, len, &t_next) < 0) {
+      return -1;
+    }
+    if (!atomic_load(&sim->stop)) {
+      atomic_store(&sim->line_times[i % LINE_TIMES_LEN], osp3sim_now_ns());
+      atomic_store(&sim->lines_written, i + 1);
+    }
+  }
+  return 0;
+}
+
+static void* sim_thread(void* arg) {
+  osp3sim* sim = (osp3sim*) arg;
+  sim->thread_ret = osp3sim_run(sim) < 0 ? errno : 0;
+  return NULL;
+}
+
+int osp3sim_start(osp3sim* sim) {
+  int err;
+  if (sim->thread_started) {
+    errno = EBUSY;
+    return -1;
+  }
+  if ((err = pthread_create(&sim->thread, NULL, sim_thread, sim)) != 0) {
+    errno = err;
+    return -1;
+  }
+  sim->thread_started = 1;
+  return 0;
+}
+
+void osp3sim_stop(osp3sim* sim) {
+  atomic_store(&sim->stop, 1);
+}
+
+int osp3sim_join(osp3sim* sim) {
+  int err;
+  if (!sim->thread_started) {
+    return 0;
+  }
+  if ((err = pthread_join(sim->thread, NULL)) != 0) {
+    errno = err;
+    return -1;
+  }
+  sim->thread_started = 0;
+  if (sim->thread_ret) {
+    errno = sim->thread_ret;
+    return -1;
+  }
+  return 0;
+}
+
+unsigned long osp3sim_lines_written(const osp3sim* sim) {
+  return atomic_load(&sim->lines_written);
+}
+
+unsigned long osp3sim_lines_intact(const osp3sim* sim, unsigned long* faulted) {
+  const unsigned long written = atomic_load(&sim->lines_written);
+  const unsigned long lines_faulted = atomic_load(&sim->lines_faulted);
+  if (faulted != NULL) {
+    *faulted = lines_faulted;
+  }
+  return written > lines_faulted ? written - lines_faulted : 0;
+}
+
+int osp3sim_line_time(const osp3sim* sim, unsigned long ms, uint64_t* ns) {
+  if (ms < sim->cfg.ms_start) {
+    errno = EINVAL;
+    return -1;
+  }
+  const unsigned long i = (ms - sim->cfg.ms_start) / sim->gen.ms_step;
+  const unsigned long written = atomic_load(&sim->lines_written);
+  if (i >= written || written - i > LINE_TIMES_LEN / 2) {
+    errno = ERANGE;
+    return -1;
+  }
+  *ns = atomic_load(&sim->line_times[i % LINE_TIMES_LEN]);
+  return 0;
+}
+
+int osp3sim_close(osp3sim* sim) {
+  int ret = 0;
+  if (sim == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  osp3sim_stop(sim);
+  if (osp3sim_join(sim) < 0) {
+    ret = -1;
+  }
+  if (sim->fd_owned) {
+    if (sim->fd_slave >= 0 && close(sim->fd_slave) < 0) {
+      ret = -1;
+    }
+    if (sim->fd >= 0 && close(sim->fd) < 0) {
+      ret = -1;
+    }
+  }
+  free(sim);
+  return ret;
+}
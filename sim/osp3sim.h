@@ -0,0 +1,319 @@
+/**
+ * A simulated ODROID Smart Power 3 (OSP3) for testing and benchmarking.
+ *
+ * The simulator creates a pseudo-terminal and writes valid, checksummed log entries to it, so the pty's slave device
+ * can be opened with `osp3_open_path` like a real device.
+ * Writes are split into USB-like packets and paced to match the configured baud rate and logging interval.
+ * Faults (corrupted, truncated, or noisy lines and bursty delivery) may be injected to test reader recovery.
+ *
+ * The simulator is not part of the installed library.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#ifndef _OSP3SIM_H_
+#define _OSP3SIM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <osp3.h>
+
+/**
+ * Shape of the simulated output channel load.
+ */
+typedef enum osp3sim_waveform {
+  // Steady load with measurement noise.
+  OSP3SIM_WAVEFORM_CONSTANT,
+  // Smoothly varying load.
+  OSP3SIM_WAVEFORM_SINE,
+  // Alternating idle and busy phases (step load).
+  OSP3SIM_WAVEFORM_SQUARE,
+  // Bounded random walk.
+  OSP3SIM_WAVEFORM_RANDOM,
+  // All channels off and zero-valued (except input voltage).
+  OSP3SIM_WAVEFORM_IDLE,
+} osp3sim_waveform;
+
+/**
+ * Maximum length of an injected noise burst.
+ */
+#define OSP3SIM_BURST_LEN_MAX 1024
+
+/**
+ * Buffer size sufficient for a line after faults are applied (every byte duplicated, plus a noise burst).
+ */
+#define OSP3SIM_FAULTS_OUT_MAX (2 * OSP3_LOG_PROTOCOL_SIZE + OSP3SIM_BURST_LEN_MAX)
+
+/**
+ * Fault injection rates, in parts per million (ppm).
+ * All zero (the default) disables fault injection.
+ */
+typedef struct osp3sim_faults {
+  // Per byte: drop the byte.
+  uint32_t drop_ppm;
+  // Per byte: flip a random bit.
+  uint32_t flip_ppm;
+  // Per byte: write the byte twice.
+  uint32_t dup_ppm;
+  // Per line: cut the line short at a random position (including its newline), e.g., as if the device reset.
+  uint32_t truncate_ppm;
+  // Per line: insert a burst of random bytes at a random position, e.g., line noise.
+  uint32_t burst_ppm;
+  // Length of noise bursts (at most `OSP3SIM_BURST_LEN_MAX`).
+  size_t burst_len;
+  // Per packet: split the packet into a shorter write.
+  uint32_t split_ppm;
+  // Per packet: stall for `delay_ms` before writing the packet, e.g., bursty delivery.
+  uint32_t delay_ppm;
+  unsigned int delay_ms;
+} osp3sim_faults;
+
+typedef struct osp3sim_config {
+  // Device logging interval; 0 writes lines back-to-back (still subject to baud pacing).
+  unsigned int interval_ms;
+  // Baud rate used for pacing writes; 0 disables pacing.
+  unsigned int baud;
+  // If non-zero (and `baud` is set), garble packets while the reader has configured the pty for a different baud rate,
+  // like a real serial link - for testing baud rate detection.
+  int baud_check;
+  // Maximum bytes per write; 0 uses `OSP3_W_MAX_PACKET_SIZE`.
+  size_t packet_size;
+  // Number of lines to write; 0 for unlimited.
+  unsigned long count;
+  // Device timestamp of the first line.
+  unsigned long ms_start;
+  osp3sim_waveform waveform;
+  // PRNG seed, for repeatable output.
+  uint32_t seed;
+  osp3sim_faults faults;
+} osp3sim_config;
+
+/**
+ * Log entry generator state.
+ */
+typedef struct osp3sim_gen {
+  osp3sim_waveform waveform;
+  unsigned long ms;
+  unsigned int ms_step;
+  uint32_t rng;
+  unsigned int walk_mA;
+} osp3sim_gen;
+
+/**
+ * Reader-side metrics for recovery from injected faults.
+ */
+typedef struct osp3sim_recovery {
+  // Lines the simulator wrote without faults (ground truth).
+  unsigned long lines_intact;
+  // Lines the simulator wrote with faults.
+  unsigned long lines_faulted;
+  // Valid log entries received by the reader.
+  unsigned long samples_good;
+  // Invalid lines and read errors encountered by the reader.
+  unsigned long samples_bad;
+  // Number of recoveries from a run of bad samples.
+  unsigned long resyncs;
+  // Longest run of consecutive bad samples.
+  unsigned long resync_run_max;
+  // Longest and total time from the first bad sample in a run to the next good sample.
+  uint64_t resync_ns_max;
+  uint64_t resync_ns_total;
+  // Internal state.
+  unsigned long run;
+  uint64_t run_start_ns;
+} osp3sim_recovery;
+
+/**
+ * Opaque simulator handle.
+ */
+typedef struct osp3sim osp3sim;
+
+/**
+ * Initialize a configuration with defaults: 10 ms interval, unpaced, 64 byte packets, unlimited lines, sine waveform,
+ * and no faults.
+ *
+ * @param cfg The configuration
+ */
+void osp3sim_config_init(osp3sim_config* cfg);
+
+/**
+ * A small, fast PRNG (xorshift32).
+ *
+ * @param state The PRNG state - must be non-zero
+ * @return The next value
+ */
+uint32_t osp3sim_rand(uint32_t* state);
+
+/**
+ * Initialize a log entry generator.
+ *
+ * @param gen The generator
+ * @param cfg The configuration
+ */
+void osp3sim_gen_init(osp3sim_gen* gen, const osp3sim_config* cfg);
+
+/**
+ * Generate the next log entry.
+ * Checksum fields are not populated.
+ *
+ * @param gen The generator
+ * @param entry The entry to populate
+ */
+void osp3sim_gen_next(osp3sim_gen* gen, osp3_log_entry* entry);
+
+/**
+ * Apply byte- and line-level faults to a line.
+ *
+ * @param faults The fault rates
+ * @param rng The PRNG state
+ * @param line The source line
+ * @param len The source line length
+ * @param out The destination buffer, at least `OSP3SIM_FAULTS_OUT_MAX` bytes when `len <= OSP3_LOG_PROTOCOL_SIZE`
+ * @param out_len The number of bytes written to `out`
+ * @return 0 if the line is unchanged, 1 if any fault was applied
+ */
+int osp3sim_faults_apply(const osp3sim_faults* faults, uint32_t* rng, const char* line, size_t len, char* out,
+                         size_t* out_len);
+
+/**
+ * Initialize recovery metrics.
+ *
+ * @param rec The metrics
+ */
+void osp3sim_recovery_init(osp3sim_recovery* rec);
+
+/**
+ * Record a sample outcome at the reader.
+ *
+ * @param rec The metrics
+ * @param good Non-zero if the sample was a valid log entry
+ * @param now_ns The current time (CLOCK_MONOTONIC) in nanoseconds
+ */
+void osp3sim_recovery_record(osp3sim_recovery* rec, int good, uint64_t now_ns);
+
+/**
+ * Collect ground truth from the simulator, after it has finished writing.
+ *
+ * @param rec The metrics
+ * @param sim The simulator
+ */
+void osp3sim_recovery_finish(osp3sim_recovery* rec, const osp3sim* sim);
+
+/**
+ * Get the fraction of intact lines that the reader recovered as valid samples.
+ * This may slightly exceed 1, since some faults are benign (e.g., a flipped bit that changes the case of a hex digit).
+ *
+ * @param rec The metrics
+ * @return The recovery rate
+ */
+double osp3sim_recovery_rate(const osp3sim_recovery* rec);
+
+/**
+ * Create a simulator and its pseudo-terminal.
+ * No data is written until `osp3sim_start` or `osp3sim_run` is called.
+ *
+ * @param cfg The configuration, or NULL for defaults
+ * @return A simulator handle, or NULL on failure
+ */
+osp3sim* osp3sim_open(const osp3sim_config* cfg);
+
+/**
+ * Create a simulator that writes to an existing file descriptor (e.g., a pipe or standard output) instead of a pty.
+ * The file descriptor is not closed by `osp3sim_close`.
+ *
+ * @param cfg The configuration, or NULL for defaults
+ * @param fd The file descriptor
+ * @return A simulator handle, or NULL on failure
+ */
+osp3sim* osp3sim_open_fd(const osp3sim_config* cfg, int fd);
+
+/**
+ * Get the path of the pty slave device, for use with `osp3_open_path`.
+ *
+ * @param sim The simulator
+ * @return The device path, or NULL if not using a pty
+ */
+const char* osp3sim_path(const osp3sim* sim);
+
+/**
+ * Write log entries on the calling thread until the configured count is reached or `osp3sim_stop` is called.
+ *
+ * @param sim The simulator
+ * @return 0 on success, -1 on error
+ */
+int osp3sim_run(osp3sim* sim);
+
+/**
+ * Write log entries on a background thread.
+ *
+ * @param sim The simulator
+ * @return 0 on success, -1 on error
+ */
+int osp3sim_start(osp3sim* sim);
+
+/**
+ * Request that writing stop (async-signal-safe).
+ *
+ * @param sim The simulator
+ */
+void osp3sim_stop(osp3sim* sim);
+
+/**
+ * Wait for the background thread to finish writing.
+ *
+ * @param sim The simulator
+ * @return 0 on success, -1 on error (including errors encountered by the background thread)
+ */
+int osp3sim_join(osp3sim* sim);
+
+/**
+ * Get the number of lines completely written so far.
+ *
+ * @param sim The simulator
+ * @return The line count
+ */
+unsigned long osp3sim_lines_written(const osp3sim* sim);
+
+/**
+ * Get the number of lines written without (and with) faults so far.
+ *
+ * @param sim The simulator
+ * @param faulted The number of lines written with faults (may be NULL)
+ * @return The number of lines written without faults
+ */
+unsigned long osp3sim_lines_intact(const osp3sim* sim, unsigned long* faulted);
+
+/**
+ * Get the time (CLOCK_MONOTONIC) that the final byte of a recently written line was written.
+ *
+ * @param sim The simulator
+ * @param ms The line's device timestamp
+ * @param ns The write time in nanoseconds
+ * @return 0 on success, -1 if the line is unknown or too old
+ */
+int osp3sim_line_time(const osp3sim* sim, unsigned long ms, uint64_t* ns);
+
+/**
+ * Stop writing (if necessary) and destroy the simulator.
+ *
+ * @param sim The simulator
+ * @return 0 on success, -1 on error
+ */
+int osp3sim_close(osp3sim* sim);
+
+/**
+ * Get the current CLOCK_MONOTONIC time.
+ *
+ * @return The time in nanoseconds
+ */
+uint64_t osp3sim_now_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * OSP3 line latency instrumentation.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <osp3.h>
+#include "osp3i.h"
+
+#ifdef OSP3_LATENCY
+
+#include <string.h>
+
+#define SUB_BUCKETS (1u << OSP3I_LATENCY_SUB_BITS)
+
+static unsigned int hist_index(uint64_t ns) {
+  if (ns < SUB_BUCKETS) {
+    return (unsigned int) ns;
+  }
+  unsigned int exp = 63 - (unsigned int) __builtin_clzll(ns);
+  if (exp > OSP3I_LATENCY_EXP_MAX) {
+    return OSP3I_LATENCY_BUCKETS - 1;
+  }
+  const unsigned int sub = (unsigned int) (ns >> (exp - OSP3I_LATENCY_SUB_BITS)) & (SUB_BUCKETS - 1);
+  return ((exp - OSP3I_LATENCY_SUB_BITS + 1) << OSP3I_LATENCY_SUB_BITS) + sub;
+}
+
+// The highest value that maps to a bucket.
+static uint64_t hist_value(unsigned int idx) {
+  if (idx < SUB_BUCKETS) {
+    return idx;
+  }
+  const unsigned int exp = (idx >> OSP3I_LATENCY_SUB_BITS) + OSP3I_LATENCY_SUB_BITS - 1;
+  const uint64_t sub = idx & (SUB_BUCKETS - 1);
+  const unsigned int shift = exp - OSP3I_LATENCY_SUB_BITS;
+  return ((SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+static void hist_record(osp3i_latency_hist* h, uint64_t ns) {
+  atomic_fetch_add_explicit(&h->buckets[hist_index(ns)], 1, memory_order_relaxed);
+  uint64_t max = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+  while (ns > max &&
+         !atomic_compare_exchange_weak_explicit(&h->max_ns, &max, ns, memory_order_relaxed, memory_order_relaxed));
+}
+
+void osp3i_latency_line(osp3_device* dev, uint64_t first_ns, uint64_t complete_ns) {
+  dev->lat.first_ns = first_ns;
+  dev->lat.complete_ns = complete_ns;
+  dev->lat.parsed = 0;
+  dev->lat.delivered = 0;
+  hist_record(&dev->lat.hist[OSP3_LATENCY_STAGE_ASSEMBLY], complete_ns - first_ns);
+}
+
+int osp3_latency_mark(osp3_device* dev, osp3_latency_mark_event event) {
+  if (dev == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  osp3i_latency* lat = &dev->lat;
+  if (lat->complete_ns == 0) {
+    // No line yet.
+    return 0;
+  }
+  const uint64_t now = osp3i_now_ns();
+  switch (event) {
+    case OSP3_LATENCY_MARK_PARSED:
+      if (!lat->parsed && !lat->delivered) {
+        lat->parsed = 1;
+        lat->parsed_ns = now;
+        hist_record(&lat->hist[OSP3_LATENCY_STAGE_PARSE], now - lat->complete_ns);
+      }
+      break;
+    case OSP3_LATENCY_MARK_DELIVERED:
+      if (!lat->delivered) {
+        lat->delivered = 1;
+        hist_record(&lat->hist[OSP3_LATENCY_STAGE_DELIVERY], now - (lat->parsed ? lat->parsed_ns : lat->complete_ns));
+        hist_record(&lat->hist[OSP3_LATENCY_STAGE_TOTAL], now - lat->first_ns);
+      }
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  return 0;
+}
+
+int osp3_latency_get(const osp3_device* dev, osp3_latency_stage stage, osp3_latency_stats* stats) {
+  if (dev == NULL || stats == NULL || (unsigned int) stage >= OSP3_LATENCY_STAGE_COUNT) {
+    errno = EINVAL;
+    return -1;
+  }
+  // Snapshot first, since lines may be recorded concurrently.
+  uint64_t counts[OSP3I_LATENCY_BUCKETS];
+  const osp3i_latency_hist* h = &dev->lat.hist[stage];
+  memset(stats, 0, sizeof(*stats));
+  for (unsigned int i = 0; i < OSP3I_LATENCY_BUCKETS; i++) {
+    counts[i] = atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    stats->count += counts[i];
+  }
+  stats->max_ns = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+  if (stats->count == 0) {
+    return 0;
+  }
+  // Nearest-rank percentiles.
+  const uint64_t rank_p50 = (stats->count * 50 + 99) / 100;
+  const uint64_t rank_p99 = (stats->count * 99 + 99) / 100;
+  uint64_t seen = 0;
+  for (unsigned int i = 0; i < OSP3I_LATENCY_BUCKETS && seen < rank_p99; i++) {
+    seen += counts[i];
+    if (stats->p50_ns == 0 && seen >= rank_p50) {
+      stats->p50_ns = hist_value(i);
+    }
+    if (seen >= rank_p99) {
+      stats->p99_ns = hist_value(i);
+    }
+  }
+  // Bucket bounds may overshoot the exact maximum.
+  if (stats->p50_ns > stats->max_ns) {
+    stats->p50_ns = stats->max_ns;
+  }
+  if (stats->p99_ns > stats->max_ns) {
+    stats->p99_ns = stats->max_ns;
+  }
+  return 0;
+}
+
+int osp3_latency_reset(osp3_device* dev) {
+  if (dev == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  for (unsigned int s = 0; s < OSP3_LATENCY_STAGE_COUNT; s++) {
+    for (unsigned int i = 0; i < OSP3I_LATENCY_BUCKETS; i++) {
+      atomic_store_explicit(&dev->lat.hist[s].buckets[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&dev->lat.hist[s].max_ns, 0, memory_order_relaxed);
+  }
+  return 0;
+}
+
+#else
+
+int osp3_latency_mark(osp3_device* dev, osp3_latency_mark_event event) {
+  (void) dev;
+  (void) event;
+  errno = ENOTSUP;
+  return -1;
+}
+
+int osp3_latency_get(const osp3_device* dev, osp3_latency_stage stage, osp3_latency_stats* stats) {
+  (void) dev;
+  (void) stage;
+  (void) stats;
+  errno = ENOTSUP;
+  return -1;
+}
+
+int osp3_latency_reset(osp3_device* dev) {
+  (void) dev;
+  errno = ENOTSUP;
+  return -1;
+}
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * OSP3 line arrival prediction.
+ *
+ * Learns the period and phase of line arrivals from host timestamps, so a reader can sleep until a line is expected to
+ * be complete instead of waking for each packet.
+ * The phase is tracked as a phase-locked loop: a line that completes while being read gives its exact arrival time,
+ * which corrects the phase and (slightly) the period.
+ * A line that's already complete on waking only bounds its arrival time, so the expected time is nudged earlier until
+ * a read catches an arrival again.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <osp3.h>
+#include "osp3i.h"
+
+// Wake this long after a line is expected to be complete, to allow for delivery jitter (e.g., USB frames).
+#define PREDICT_MARGIN_NS 500000
+// A read that takes longer than this waited for data.
+#define PREDICT_BLOCKED_NS 100000
+// The initial nudge, which doubles after each run of lines that were already complete on waking.
+#define PREDICT_NUDGE_NS 20000
+#define PREDICT_NUDGE_LINES 16
+// Phase errors beyond this fraction of the period are lost lines or stalls, not drift.
+#define PREDICT_ERROR_DIV 4
+// Period correction gain, as a divisor of the phase error.
+#define PREDICT_GAIN_DIV 16
+
+static int cmp_u64(const void* a, const void* b) {
+  const uint64_t x = *(const uint64_t*) a;
+  const uint64_t y = *(const uint64_t*) b;
+  return x < y ? -1 : x > y;
+}
+
+void osp3i_predict_reset(osp3_device* dev) {
+  const int enabled = dev->pred.enabled;
+  memset(&dev->pred, 0, sizeof(dev->pred));
+  dev->pred.enabled = enabled;
+  dev->pred.nudge_ns = PREDICT_NUDGE_NS;
+}
+
+void osp3i_predict_sleep(osp3_device* dev, unsigned int timeout_ms) {
+  osp3i_predict* p = &dev->pred;
+  uint64_t now = osp3i_now_ns();
+  if (p->period_ns > 0) {
+    const uint64_t target = p->expect_ns + PREDICT_MARGIN_NS;
+    // Don't sleep past the timeout, or for longer than a period or so (the model is stale).
+    if (target > now && target - now < 2 * p->period_ns && (timeout_ms == 0 || target - now < timeout_ms * 1000000ull)) {
+      osp3i_sleep_until_ns(target);
+      now = osp3i_now_ns();
+    }
+  }
+  p->read_ns = now;
+}
+
+void osp3i_predict_line(osp3_device* dev, uint64_t complete_ns) {
+  osp3i_predict* p = &dev->pred;
+  if (p->period_ns == 0) {
+    // Learn the period from the median interval between lines, which is robust to lost lines and stalls.
+    if (p->last_ns > 0) {
+      p->deltas[p->ndeltas++] = complete_ns - p->last_ns;
+      if (p->ndeltas == OSP3I_PREDICT_LEARN_LINES) {
+        uint64_t sorted[OSP3I_PREDICT_LEARN_LINES];
+        memcpy(sorted, p->deltas, sizeof(sorted));
+        qsort(sorted, OSP3I_PREDICT_LEARN_LINES, sizeof(sorted[0]), cmp_u64);
+        p->period_ns = sorted[OSP3I_PREDICT_LEARN_LINES / 2];
+        p->ndeltas = 0;
+        p->expect_ns = complete_ns + p->period_ns;
+      }
+    }
+    p->last_ns = complete_ns;
+    return;
+  }
+  if (complete_ns - p->read_ns > PREDICT_BLOCKED_NS) {
+    // The line completed while reading, so this is its arrival time.
+    const int64_t err = (int64_t) (complete_ns - p->expect_ns);
+    const int64_t err_max = (int64_t) (p->period_ns / PREDICT_ERROR_DIV);
+    if (err < err_max && err > -err_max) {
+      p->period_ns = (uint64_t) ((int64_t) p->period_ns + err / PREDICT_GAIN_DIV);
+    }
+    p->expect_ns = complete_ns + p->period_ns;
+    p->nudge_ns = PREDICT_NUDGE_NS;
+    p->complete_run = 0;
+  } else {
+    // Already complete, so it arrived earlier than expected by an unknown amount.
+    if (++p->complete_run % PREDICT_NUDGE_LINES == 0 && p->nudge_ns < p->period_ns / PREDICT_ERROR_DIV) {
+      p->nudge_ns *= 2;
+    }
+    p->expect_ns += p->period_ns - p->nudge_ns;
+  }
+  p->last_ns = complete_ns;
+}
@@ -0,0 +1,133 @@
+/**
+ * OSP3 baud rate and logging interval detection.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <osp3.h>
+#include "osp3i.h"
+
+// Large enough to read lines at the wrong baud rate (which may lack newlines) without overflowing too often.
+#define PROBE_LINE_LEN_MAX (2 * OSP3_LOG_PROTOCOL_SIZE)
+
+// A correct baud rate yields at most one bad line (the first may be incomplete), so give up on a rate after more.
+#define PROBE_BAD_LINES_MAX 2
+
+// Allow for USB and scheduling delays when deriving read timeouts.
+#define PROBE_TIMEOUT_SLACK_MS 20
+
+// The device UI's default first, then the fastest (likely for short intervals), then the rest from fastest to slowest.
+static const unsigned int probe_bauds[] = {
+  OSP3_BAUD_DEFAULT, 921600, 576000, 500000, 460800, 230400, 57600, 38400, 19200, 9600
+};
+
+// Returns 1 if the baud rate was detected, 0 if not, or -1 on error (errno is set to ETIME if nothing was received).
+static int probe_baud(osp3_device* dev, unsigned int baud, unsigned int timeout_ms, osp3_probe_info* info) {
+  unsigned char line[PROBE_LINE_LEN_MAX + 1];
+  osp3_log_entry entry;
+  unsigned long ms_prev = 0;
+  int ms_valid = 0;
+  unsigned int bad = 0;
+  size_t received = 0;
+  size_t transferred;
+  size_t discarded;
+  if (osp3i_serial_configure(dev, baud) < 0) {
+    // Not supported by the platform.
+    return 0;
+  }
+  if (osp3_flush(dev) < 0) {
+    return -1;
+  }
+  const uint64_t deadline_ns = osp3i_now_ns() + timeout_ms * 1000000ull;
+  while (bad <= PROBE_BAD_LINES_MAX) {
+    const uint64_t now = osp3i_now_ns();
+    if (now >= deadline_ns) {
+      break;
+    }
+    discarded = 0;
+    const unsigned int remaining_ms = (unsigned int) ((deadline_ns - now + 999999) / 1000000);
+    if (osp3_read_line_resync(dev, line, PROBE_LINE_LEN_MAX, &transferred, &discarded, remaining_ms) < 0) {
+      if (errno == ETIME) {
+        break;
+      }
+      return -1;
+    }
+    received += transferred + discarded;
+    if (discarded > 0) {
+      bad++;
+    }
+    line[transferred] = '\0';
+    // Don't use `osp3_log_verify`, which would record failures in the device's counters.
+    if (transferred != OSP3_LOG_PROTOCOL_SIZE || osp3_log_parse((const char*) line, transferred, &entry) ||
+        osp3_log_checksum_test((const char*) line, transferred, entry.checksum8_2s_compl, entry.checksum8_xor)) {
+      bad++;
+      ms_valid = 0;
+      continue;
+    }
+    // Consecutive valid lines give the interval, unless an entry was lost or the device was reset in between.
+    if (ms_valid && entry.ms > ms_prev && entry.ms - ms_prev >= OSP3_INTERVAL_MS_MIN &&
+        entry.ms - ms_prev <= OSP3_INTERVAL_MS_MAX) {
+      // Start bit, 8 data bits, and stop bit, rounded up.
+      const unsigned int line_ms = (OSP3_LOG_PROTOCOL_SIZE * 10 * 1000 + baud - 1) / baud;
+      info->baud = baud;
+      info->interval_ms = (unsigned int) (entry.ms - ms_prev);
+      // The next line should be complete within an interval (plus its transmission time), so allow twice that.
+      info->timeout_ms = 2 * info->interval_ms + line_ms + PROBE_TIMEOUT_SLACK_MS;
+      return 1;
+    }
+    ms_prev = entry.ms;
+    ms_valid = 1;
+  }
+  if (received == 0) {
+    // The device isn't logging, so other baud rates won't help.
+    errno = ETIME;
+    return -1;
+  }
+  return 0;
+}
+
+osp3_device* osp3_open_path_probe(const char* path, unsigned int timeout_ms, osp3_probe_info* info) {
+  osp3_device* dev;
+  int ret = 0;
+  if (path == NULL || info == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((dev = osp3i_device_new()) == NULL) {
+    return NULL;
+  }
+  if (osp3i_open_path(dev, path, probe_bauds[0]) < 0) {
+    osp3i_device_free(dev);
+    return NULL;
+  }
+  if (timeout_ms == 0) {
+    timeout_ms = OSP3_PROBE_TIMEOUT_MS_DEFAULT;
+  }
+  for (size_t i = 0; i < sizeof(probe_bauds) / sizeof(probe_bauds[0]) && ret == 0; i++) {
+    ret = probe_baud(dev, probe_bauds[i], timeout_ms, info);
+  }
+  if (ret <= 0) {
+    if (ret == 0) {
+      // Data was received, but never valid log entries.
+      errno = EPROTO;
+    }
+    const int err = errno;
+    osp3i_close(dev);
+    osp3i_device_free(dev);
+    errno = err;
+    return NULL;
+  }
+  // Start counting from here, as if opened with the detected baud rate - lines after those probed are still buffered.
+  memset(&dev->stats, 0, sizeof(dev->stats));
+  if (dev->transport->icount != NULL && dev->transport->icount(dev, &dev->stats.icount_base) == 0) {
+    dev->stats.icount_supported = 1;
+    dev->stats.icount_last = dev->stats.icount_base;
+  }
+#ifdef OSP3_LATENCY
+  osp3_latency_reset(dev);
+#endif
+  return dev;
+}
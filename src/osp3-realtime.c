@@ -0,0 +1,108 @@
+/**
+ * OSP3 real-time reading support.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#ifdef __linux__
+// For CPU_SET and sched_setaffinity.
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <osp3.h>
+#include "osp3i.h"
+
+// Stack locked below the caller's frame, which easily covers the read path's deepest call chain.
+#define REALTIME_STACK_LOCK_SIZE (64 * 1024)
+
+// Lock (and fault in) the stack pages that calls from the caller's frame will use.
+__attribute__((noinline))
+static int lock_stack(void) {
+  unsigned char stack[REALTIME_STACK_LOCK_SIZE];
+  memset(stack, 0, sizeof(stack));
+  // The pages remain locked after returning, since the stack isn't unmapped.
+  return mlock(stack, sizeof(stack));
+}
+
+int osp3i_realtime_lock(osp3_device* dev, void* addr, size_t len) {
+  return dev->rt.locked && addr != NULL ? mlock(addr, len) : 0;
+}
+
+void osp3i_realtime_unlock(osp3_device* dev) {
+  if (!dev->rt.locked) {
+    return;
+  }
+  // Pages may be shared with other allocations, but locked memory isn't a resource worth tracking more precisely.
+  if (dev->fdbuf.buf != NULL) {
+    munlock(dev->fdbuf.buf, dev->fdbuf.cap);
+  }
+  if (dev->coal.buf != NULL) {
+    munlock(dev->coal.buf, dev->coal.cap);
+  }
+  munlock(dev, sizeof(*dev));
+  dev->rt.locked = 0;
+}
+
+static int set_cpu(int cpu) {
+#ifdef __linux__
+  cpu_set_t set;
+  if (cpu >= CPU_SETSIZE) {
+    errno = EINVAL;
+    return -1;
+  }
+  CPU_ZERO(&set);
+  CPU_SET((size_t) cpu, &set);
+  // On Linux, 0 is the calling thread (not the whole process).
+  return sched_setaffinity(0, sizeof(set), &set);
+#else
+  (void) cpu;
+  errno = ENOTSUP;
+  return -1;
+#endif
+}
+
+static int set_fifo(int priority) {
+#ifdef __linux__
+  const struct sched_param param = { .sched_priority = priority };
+  if (priority < sched_get_priority_min(SCHED_FIFO) || priority > sched_get_priority_max(SCHED_FIFO)) {
+    errno = EINVAL;
+    return -1;
+  }
+  // As with affinity, this only applies to the calling thread.
+  return sched_setscheduler(0, SCHED_FIFO, &param);
+#else
+  (void) priority;
+  errno = ENOTSUP;
+  return -1;
+#endif
+}
+
+int osp3_set_realtime(osp3_device* dev, const osp3_realtime* rt) {
+  if (dev == NULL || rt == NULL || rt->cpu < -1 || rt->fifo_priority < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (rt->cpu >= 0 && set_cpu(rt->cpu) < 0) {
+    return -1;
+  }
+  if (rt->fifo_priority > 0 && set_fifo(rt->fifo_priority) < 0) {
+    return -1;
+  }
+  if (rt->lock_memory && !dev->rt.locked) {
+    if (mlock(dev, sizeof(*dev)) < 0) {
+      return -1;
+    }
+    dev->rt.locked = 1;
+    if (osp3i_realtime_lock(dev, dev->fdbuf.buf, dev->fdbuf.cap) < 0 ||
+        osp3i_realtime_lock(dev, dev->coal.buf, dev->coal.cap) < 0 || lock_stack() < 0) {
+      const int err = errno;
+      osp3i_realtime_unlock(dev);
+      errno = err;
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -10,8 +10,92 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <osp3.h>
 #include "osp3i.h"
+#include "osp3i-probes.h"
+
+#ifdef OSP3_USDT
+volatile unsigned short osp3_read_start_semaphore __attribute__((section(".probes")));
+volatile unsigned short osp3_read_end_semaphore __attribute__((section(".probes")));
+volatile unsigned short osp3_line_semaphore __attribute__((section(".probes")));
+volatile unsigned short osp3_parse_semaphore __attribute__((section(".probes")));
+volatile unsigned short osp3_checksum_semaphore __attribute__((section(".probes")));
+volatile unsigned short osp3_verify_semaphore __attribute__((section(".probes")));
+#endif
+
+static size_t sz_min(size_t a, size_t b) {
+  return a <= b ? a : b;
+}
+
+static size_t align_up(size_t size) {
+  return (size + OSP3_DEVICE_ALIGN - 1) & ~((size_t) OSP3_DEVICE_ALIGN - 1);
+}
+
+osp3_device* osp3i_device_new(void) {
+  // Aligned like caller-provided storage, so devices read by different threads never share a cache line.
+  const size_t size = align_up(sizeof(osp3_device));
+  osp3_device* dev = aligned_alloc(OSP3_DEVICE_ALIGN, size);
+  if (dev != NULL) {
+    memset(dev, 0, size);
+  }
+  return dev;
+}
+
+void osp3i_device_free(osp3_device* dev) {
+  if (!dev->storage) {
+    free(dev);
+  }
+}
+
+size_t osp3_device_size(const osp3_buffer_opts* opts) {
+  size_t size = align_up(sizeof(osp3_device));
+  if (opts != NULL) {
+    size += align_up(opts->fd_buf_size) + align_up(opts->coalesce_buf_size);
+  }
+  return size;
+}
+
+// Lay out a device and its buffers in caller-provided storage.
+static osp3_device* device_init(void* storage, size_t storage_size, const osp3_buffer_opts* opts,
+                                unsigned char** fd_buf) {
+  if (storage == NULL || (uintptr_t) storage % OSP3_DEVICE_ALIGN != 0 || storage_size < osp3_device_size(opts)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  memset(storage, 0, align_up(sizeof(osp3_device)));
+  osp3_device* dev = storage;
+  unsigned char* next = (unsigned char*) storage + align_up(sizeof(osp3_device));
+  dev->storage = 1;
+  *fd_buf = NULL;
+  if (opts != NULL && opts->fd_buf_size > 0) {
+    *fd_buf = next;
+    next += align_up(opts->fd_buf_size);
+  }
+  if (opts != NULL && opts->coalesce_buf_size > 0) {
+    dev->coal.storage_buf = next;
+    dev->coal.buf_size = opts->coalesce_buf_size;
+  }
+  return dev;
+}
+
+static osp3_device* open_path(osp3_device* dev, const char* path, unsigned int baud, int flush) {
+  if (osp3i_open_path(dev, path, baud > 0 ? baud : OSP3_BAUD_DEFAULT) < 0) {
+    osp3i_device_free(dev);
+    return NULL;
+  }
+  if (flush && osp3_flush(dev) < 0) {
+    osp3i_close(dev);
+    osp3i_device_free(dev);
+    return NULL;
+  }
+  if (dev->transport->icount != NULL && dev->transport->icount(dev, &dev->stats.icount_base) == 0) {
+    dev->stats.icount_supported = 1;
+    dev->stats.icount_last = dev->stats.icount_base;
+  }
+  return dev;
+}
 
 osp3_device* osp3_open_path(const char* path, unsigned int baud) {
   osp3_device* dev;
@@ -19,16 +103,185 @@ osp3_device* osp3_open_path(const char* path, unsigned int baud) {
     errno = EINVAL;
     return NULL;
   }
-  if ((dev = calloc(1, sizeof(osp3_device))) == NULL) {
+  if ((dev = osp3i_device_new()) == NULL) {
     return NULL;
   }
-  if (osp3i_open_path(dev, path, baud > 0 ? baud : OSP3_BAUD_DEFAULT) < 0) {
-    free(dev);
+  return open_path(dev, path, baud, 1);
+}
+
+osp3_device* osp3_open_path_into(void* storage, size_t storage_size, const osp3_buffer_opts* opts, const char* path,
+                                 unsigned int baud) {
+  osp3_device* dev;
+  unsigned char* fd_buf;
+  if (path == NULL) {
+    errno = EINVAL;
     return NULL;
   }
-  if (osp3_flush(dev) < 0) {
-    osp3i_close(dev);
-    free(dev);
+  if ((dev = device_init(storage, storage_size, opts, &fd_buf)) == NULL) {
+    return NULL;
+  }
+  return open_path(dev, path, baud, 1);
+}
+
+osp3_device* osp3_open_fd(int fd) {
+  osp3_device* dev;
+  if (fd < 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((dev = osp3i_device_new()) == NULL) {
+    return NULL;
+  }
+  if (osp3i_open_fd(dev, fd, NULL, OSP3_FD_BUF_SIZE_DEFAULT) < 0) {
+    osp3i_device_free(dev);
+    return NULL;
+  }
+  return dev;
+}
+
+osp3_device* osp3_open_fd_into(void* storage, size_t storage_size, const osp3_buffer_opts* opts, int fd) {
+  osp3_device* dev;
+  unsigned char* fd_buf;
+  if (fd < 0 || opts == NULL || opts->fd_buf_size == 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((dev = device_init(storage, storage_size, opts, &fd_buf)) == NULL) {
+    return NULL;
+  }
+  // Can't fail with a buffer.
+  osp3i_open_fd(dev, fd, fd_buf, opts->fd_buf_size);
+  return dev;
+}
+
+osp3_device* osp3_open_follow(const char* path, int seek_end) {
+  osp3_device* dev;
+  if (path == NULL) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((dev = osp3i_device_new()) == NULL) {
+    return NULL;
+  }
+  if (osp3i_open_follow(dev, path, seek_end, OSP3_FD_BUF_SIZE_DEFAULT) < 0) {
+    osp3i_device_free(dev);
+    return NULL;
+  }
+  return dev;
+}
+
+osp3_device* osp3_open_mem(const void* buf, size_t len, size_t packet_size) {
+  osp3_device* dev;
+  if (buf == NULL && len > 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((dev = osp3i_device_new()) == NULL) {
+    return NULL;
+  }
+  if (osp3i_open_mem(dev, buf, len, packet_size) < 0) {
+    osp3i_device_free(dev);
+    return NULL;
+  }
+  return dev;
+}
+
+osp3_device* osp3_open_mem_into(void* storage, size_t storage_size, const osp3_buffer_opts* opts, const void* buf,
+                                size_t len, size_t packet_size) {
+  osp3_device* dev;
+  unsigned char* fd_buf;
+  if (buf == NULL && len > 0) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if ((dev = device_init(storage, storage_size, opts, &fd_buf)) == NULL) {
+    return NULL;
+  }
+  // Can't fail.
+  osp3i_open_mem(dev, buf, len, packet_size);
+  return dev;
+}
+
+// The size of the first version of the options - newer versions only add fields.
+#define OPEN_OPTS_SIZE_V1 (offsetof(osp3_open_opts, storage_size) + sizeof(size_t))
+
+static int clock_id(osp3_clock clock, clockid_t* clk) {
+  switch (clock) {
+    case OSP3_CLOCK_MONOTONIC:
+      *clk = CLOCK_MONOTONIC;
+      return 0;
+    case OSP3_CLOCK_REALTIME:
+      *clk = CLOCK_REALTIME;
+      return 0;
+#ifdef CLOCK_MONOTONIC_RAW
+    case OSP3_CLOCK_MONOTONIC_RAW:
+      *clk = CLOCK_MONOTONIC_RAW;
+      return 0;
+#endif
+#ifdef CLOCK_BOOTTIME
+    case OSP3_CLOCK_BOOTTIME:
+      *clk = CLOCK_BOOTTIME;
+      return 0;
+#endif
+    default:
+      errno = ENOTSUP;
+      return -1;
+  }
+}
+
+osp3_device* osp3_open_ex(const char* path, const osp3_open_opts* opts) {
+  osp3_open_opts o = OSP3_OPEN_OPTS_INIT;
+  osp3_device* dev;
+  unsigned char* fd_buf;
+  clockid_t clk = CLOCK_MONOTONIC;
+  if (path == NULL || (opts != NULL && opts->size < OPEN_OPTS_SIZE_V1)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (opts != NULL) {
+    // Options from a newer version of the library can't be honored, unless they're unset.
+    for (size_t i = sizeof(o); i < opts->size; i++) {
+      if (((const unsigned char*) opts)[i] != 0) {
+        errno = ENOTSUP;
+        return NULL;
+      }
+    }
+    memcpy(&o, opts, sz_min(opts->size, sizeof(o)));
+  }
+  if ((o.flags & ~(unsigned int) (OSP3_OPEN_NO_FLUSH | OSP3_OPEN_SKIP_PARTIAL)) != 0 ||
+      (unsigned int) o.clock > OSP3_CLOCK_BOOTTIME || (unsigned int) o.schedule > OSP3_SCHEDULE_PREDICT ||
+      o.coalesce_ms > OSP3_COALESCE_MS_MAX) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (o.clock != OSP3_CLOCK_NONE && clock_id(o.clock, &clk) < 0) {
+    return NULL;
+  }
+  if (o.storage != NULL) {
+    if ((dev = device_init(o.storage, o.storage_size, &o.buffers, &fd_buf)) == NULL) {
+      return NULL;
+    }
+  } else {
+    if ((dev = osp3i_device_new()) == NULL) {
+      return NULL;
+    }
+    dev->coal.buf_size = o.buffers.coalesce_buf_size;
+  }
+  dev->ts.enabled = o.clock != OSP3_CLOCK_NONE;
+  dev->ts.clk = clk;
+  dev->skip_partial = (o.flags & OSP3_OPEN_SKIP_PARTIAL) != 0;
+  if (o.flags & OSP3_OPEN_NO_FLUSH) {
+    dev->skip_pending = dev->skip_partial;
+  }
+  if ((dev = open_path(dev, path, o.baud, !(o.flags & OSP3_OPEN_NO_FLUSH))) == NULL) {
+    return NULL;
+  }
+  // Can't fail with valid options, except for coalescing's buffer allocation.
+  osp3_set_schedule(dev, o.schedule);
+  if (o.coalesce_ms > 0 && osp3_set_coalesce(dev, o.coalesce_ms) < 0) {
+    const int err = errno;
+    osp3_close(dev);
+    errno = err;
     return NULL;
   }
   return dev;
@@ -39,8 +292,13 @@ int osp3_close(osp3_device* dev) {
     errno = EINVAL;
     return -1;
   }
-  int ret = osp3i_close(dev);
-  free(dev);
+  // Before the transport frees its buffers.
+  osp3i_realtime_unlock(dev);
+  int ret = dev->transport->close(dev);
+  if (dev->coal.buf != dev->coal.storage_buf) {
+    free(dev->coal.buf);
+  }
+  osp3i_device_free(dev);
   return ret;
 }
 
@@ -51,11 +309,179 @@ int osp3_flush(osp3_device* dev) {
   }
   dev->rbuf.idx = 0;
   dev->rbuf.rem = 0;
-  return osp3i_flush(dev);
+  dev->coal.idx = 0;
+  dev->coal.rem = 0;
+  dev->coal.more = 0;
+  // Flushing may cut a line short.
+  dev->skip_pending = dev->skip_partial;
+  dev->oversize = 0;
+  // Arrivals may be rephased (e.g., when old data is dropped).
+  osp3i_predict_reset(dev);
+  return dev->transport->flush(dev);
 }
 
-static size_t sz_min(size_t a, size_t b) {
-  return a <= b ? a : b;
+int osp3_set_schedule(osp3_device* dev, osp3_schedule schedule) {
+  if (dev == NULL || (unsigned int) schedule > OSP3_SCHEDULE_PREDICT) {
+    errno = EINVAL;
+    return -1;
+  }
+  dev->pred.enabled = schedule == OSP3_SCHEDULE_PREDICT;
+  osp3i_predict_reset(dev);
+  return 0;
+}
+
+int osp3_set_coalesce(osp3_device* dev, unsigned int max_latency_ms) {
+  if (dev == NULL || max_latency_ms > OSP3_COALESCE_MS_MAX) {
+    errno = EINVAL;
+    return -1;
+  }
+  osp3i_coalesce* c = &dev->coal;
+  if (max_latency_ms == 0) {
+    if (c->rem > 0) {
+      // Buffered data must still be returned.
+      errno = EBUSY;
+      return -1;
+    }
+    if (c->buf != NULL && dev->rt.locked) {
+      munlock(c->buf, c->cap);
+    }
+    if (c->buf != c->storage_buf) {
+      free(c->buf);
+    }
+    c->buf = NULL;
+    c->more = 0;
+    return 0;
+  }
+  if (c->buf == NULL) {
+    // Use the caller's storage, if it has room for a buffer.
+    c->cap = c->buf_size > 0 ? c->buf_size : OSP3_COALESCE_BUF_SIZE_DEFAULT;
+    if ((c->buf = c->storage_buf) == NULL && (c->buf = malloc(c->cap)) == NULL) {
+      return -1;
+    }
+    if (osp3i_realtime_lock(dev, c->buf, c->cap) < 0) {
+      const int err = errno;
+      if (c->buf != c->storage_buf) {
+        free(c->buf);
+      }
+      c->buf = NULL;
+      errno = err;
+      return -1;
+    }
+  }
+  c->max_ns = max_latency_ms * 1000000ull;
+  // The first batch is read immediately.
+  c->next_ns = 0;
+  return 0;
+}
+
+int osp3_get_fd(const osp3_device* dev) {
+  if (dev == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (dev->fd < 0) {
+    errno = ENOTSUP;
+  }
+  return dev->fd;
+}
+
+static ssize_t transport_read(osp3_device* dev, unsigned char* buf, size_t len, unsigned int timeout_ms) {
+  if (OSP3I_PROBE_ENABLED(read_start)) {
+    OSP3I_PROBE3(read_start, dev, len, osp3i_now_ns());
+  }
+  ssize_t bytes_read = dev->transport->read(dev, buf, len, timeout_ms);
+  if (OSP3I_PROBE_ENABLED(read_end)) {
+    const int err = errno;
+    OSP3I_PROBE4(read_end, dev, bytes_read, bytes_read < 0 ? err : 0, osp3i_now_ns());
+    errno = err;
+  }
+  OSP3I_STAT_ADD(dev, reads, 1);
+  if (bytes_read > 0) {
+    if (dev->ts.enabled) {
+      dev->ts.read_ns = osp3i_clock_ns(dev->ts.clk);
+    }
+    OSP3I_STAT_ADD(dev, bytes_read, (uint64_t) bytes_read);
+  } else if (bytes_read < 0 && errno == ETIME) {
+    OSP3I_STAT_ADD(dev, timeouts, 1);
+  }
+  return bytes_read;
+}
+
+// Sleep until the next batch is due, then reduce the timeout by the time slept (errno is set to ETIME if none is left).
+static int coalesce_sleep(const osp3i_coalesce* c, unsigned int* timeout_ms) {
+  const uint64_t start = osp3i_now_ns();
+  if (c->more || c->next_ns <= start) {
+    return 0;
+  }
+  const uint64_t deadline_ns = start + *timeout_ms * 1000000ull;
+  osp3i_sleep_until_ns(*timeout_ms > 0 && c->next_ns > deadline_ns ? deadline_ns : c->next_ns);
+  if (*timeout_ms > 0) {
+    const uint64_t now = osp3i_now_ns();
+    if (now >= deadline_ns) {
+      errno = ETIME;
+      return -1;
+    }
+    // Round up, so a short remainder doesn't become an indefinite wait.
+    *timeout_ms = (unsigned int) ((deadline_ns - now + 999999) / 1000000);
+  }
+  return 0;
+}
+
+static ssize_t device_read(osp3_device* dev, unsigned char* buf, size_t len, unsigned int timeout_ms) {
+  osp3i_coalesce* c = &dev->coal;
+  if (c->buf == NULL) {
+    return transport_read(dev, buf, len, timeout_ms);
+  }
+  if (c->rem == 0) {
+    if (coalesce_sleep(c, &timeout_ms) < 0) {
+      OSP3I_STAT_ADD(dev, timeouts, 1);
+      return -1;
+    }
+    // Keep a steady cadence from when the batch was due, regardless of how long reading it takes.
+    if (!c->more) {
+      c->next_ns = osp3i_now_ns() + c->max_ns;
+    }
+    ssize_t bytes_read = transport_read(dev, c->buf, c->cap, timeout_ms);
+    if (bytes_read <= 0) {
+      return bytes_read;
+    }
+    c->idx = 0;
+    c->rem = (size_t) bytes_read;
+    c->more = c->rem == c->cap;
+  }
+  const size_t n = sz_min(c->rem, len);
+  memcpy(buf, &c->buf[c->idx], n);
+  c->idx += n;
+  c->rem -= n;
+  return (ssize_t) n;
+}
+
+int osp3_set_clock(osp3_device* dev, osp3_clock clock) {
+  clockid_t clk = CLOCK_MONOTONIC;
+  if (dev == NULL || (unsigned int) clock > OSP3_CLOCK_BOOTTIME) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (clock != OSP3_CLOCK_NONE && clock_id(clock, &clk) < 0) {
+    return -1;
+  }
+  memset(&dev->ts, 0, sizeof(dev->ts));
+  dev->ts.enabled = clock != OSP3_CLOCK_NONE;
+  dev->ts.clk = clk;
+  return 0;
+}
+
+int osp3_get_line_time(const osp3_device* dev, uint64_t* ns) {
+  if (dev == NULL || ns == NULL || !dev->ts.enabled) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (dev->ts.line_ns == 0) {
+    errno = ENODATA;
+    return -1;
+  }
+  *ns = dev->ts.line_ns;
+  return 0;
 }
 
 int osp3_read(osp3_device* dev, unsigned char* buf, size_t len, size_t* transferred, unsigned int timeout_ms) {
@@ -69,7 +495,7 @@ int osp3_read(osp3_device* dev, unsigned char* buf, size_t len, size_t* transfer
   dev->rbuf.rem -= *transferred;
   dev->rbuf.idx = dev->rbuf.rem > 0 ? dev->rbuf.idx + *transferred : 0;
   if (*transferred < len) {
-    ssize_t bytes_read = osp3i_read(dev, &buf[*transferred], len - *transferred, timeout_ms);
+    ssize_t bytes_read = device_read(dev, &buf[*transferred], len - *transferred, timeout_ms);
     if (bytes_read < 0) {
       return -1;
     }
@@ -78,6 +504,20 @@ int osp3_read(osp3_device* dev, unsigned char* buf, size_t len, size_t* transfer
   return 0;
 }
 
+int osp3_wait(const osp3_device* dev, unsigned int timeout_ms) {
+  if (dev == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  if (dev->rbuf.rem > 0 || dev->coal.rem > 0) {
+    return 0;
+  }
+  if (dev->coal.buf != NULL && coalesce_sleep(&dev->coal, &timeout_ms) < 0) {
+    return -1;
+  }
+  return dev->transport->wait(dev, timeout_ms);
+}
+
 static int lineccpy(void* restrict dst, size_t dst_sz, size_t* written, const void* restrict src, size_t src_sz) {
   const size_t sz = sz_min(dst_sz, src_sz);
   const void* ret = memccpy(dst, src, '\n', sz);
@@ -85,11 +525,54 @@ static int lineccpy(void* restrict dst, size_t dst_sz, size_t* written, const vo
   return ret == NULL ? 0 : 1;
 }
 
+// Discard data through the first newline, which ends a line that may have started before the device was opened or
+// flushed.
+static int skip_partial(osp3_device* dev, unsigned int timeout_ms) {
+  osp3_rw_buffer* rb = &dev->rbuf;
+  while (1) {
+    const unsigned char* nl = memchr(&rb->buf[rb->idx], '\n', rb->rem);
+    const size_t n = nl == NULL ? rb->rem : (size_t) (nl - &rb->buf[rb->idx]) + 1;
+    OSP3I_STAT_ADD(dev, bytes_discarded, n);
+    rb->rem -= n;
+    rb->idx = rb->rem > 0 ? rb->idx + n : 0;
+    if (nl != NULL) {
+      dev->skip_pending = 0;
+      return 0;
+    }
+    ssize_t bytes_read = device_read(dev, rb->buf, sizeof(rb->buf), timeout_ms);
+    if (bytes_read == 0) {
+      errno = ENODATA;
+    }
+    if (bytes_read <= 0) {
+      return -1;
+    }
+    rb->rem = (size_t) bytes_read;
+#ifdef OSP3_LATENCY
+    dev->lat.rbuf_ns = osp3i_now_ns();
+#endif
+  }
+}
+
 int osp3_read_line(osp3_device* dev, unsigned char* buf, size_t len, size_t* transferred, unsigned int timeout_ms) {
   if (dev == NULL || buf == NULL || transferred == NULL) {
     errno = EINVAL;
     return -1;
   }
+  if (dev->skip_pending && skip_partial(dev, timeout_ms) < 0) {
+    *transferred = 0;
+    return -1;
+  }
+#ifdef OSP3_LATENCY
+  uint64_t first_ns = dev->rbuf.rem > 0 ? dev->lat.rbuf_ns : 0;
+  uint64_t complete_ns = dev->lat.rbuf_ns;
+#endif
+  // A coalesced batch already waited for the data.
+  // A line that's already buffered whole arrived with the previous one, so it says nothing about arrival times.
+  const int predict = dev->pred.enabled && dev->coal.buf == NULL &&
+                      memchr(&dev->rbuf.buf[dev->rbuf.idx], '\n', dev->rbuf.rem) == NULL;
+  if (predict) {
+    osp3i_predict_sleep(dev, timeout_ms);
+  }
   size_t line_seg_written = 0;
   int complete = lineccpy(buf, len, &line_seg_written, &dev->rbuf.buf[dev->rbuf.idx], dev->rbuf.rem);
   *transferred = line_seg_written;
@@ -97,17 +580,38 @@ int osp3_read_line(osp3_device* dev, unsigned char* buf, size_t len, size_t* tra
   dev->rbuf.rem -= line_seg_written;
   dev->rbuf.idx = dev->rbuf.rem > 0 ? dev->rbuf.idx + line_seg_written : 0;
   while (!complete) {
-    unsigned char packet[OSP3_W_MAX_PACKET_SIZE];
+    unsigned char packet[OSP3I_RBUF_SIZE];
     assert(len >= *transferred);
-    size_t packet_sz = sz_min(sizeof(packet), len - *transferred);
+    // When a line is expected to be complete (or is in a coalesced batch), read it all at once rather than a USB packet
+    // at a time.
+    const size_t packet_max = dev->pred.enabled || dev->coal.buf != NULL ? sizeof(packet) : OSP3_W_MAX_PACKET_SIZE;
+    size_t packet_sz = sz_min(packet_max, len - *transferred);
     if (packet_sz == 0) {
+      // Count each line once, however many buffers it fills.
+      if (!dev->oversize) {
+        OSP3I_STAT_ADD(dev, lines_oversize, 1);
+        dev->oversize = 1;
+      }
       errno = ENOBUFS;
       return -1;
     }
-    ssize_t bytes_read = osp3i_read(dev, packet, packet_sz, timeout_ms);
-    if (bytes_read < 0) {
+    ssize_t bytes_read = device_read(dev, packet, packet_sz, timeout_ms);
+    if (bytes_read == 0) {
+      // End of data (e.g., the device was disconnected) - a line will never be completed.
+      errno = ENODATA;
+    }
+    if (bytes_read <= 0) {
+      if (*transferred > 0) {
+        OSP3I_STAT_ADD(dev, lines_partial, 1);
+      }
       return -1;
     }
+#ifdef OSP3_LATENCY
+    complete_ns = dev->lat.rbuf_ns = osp3i_now_ns();
+    if (first_ns == 0) {
+      first_ns = complete_ns;
+    }
+#endif
     size_t packet_written = (size_t) bytes_read;
     line_seg_written = 0;
     complete = lineccpy(&buf[*transferred], len - *transferred, &line_seg_written, packet, packet_written);
@@ -118,6 +622,87 @@ int osp3_read_line(osp3_device* dev, unsigned char* buf, size_t len, size_t* tra
     assert(dev->rbuf.rem > 0 ? complete : 1); // if we actually populate the buffer, we must be finished
     memcpy(dev->rbuf.buf, &packet[line_seg_written], dev->rbuf.rem);
   }
+  OSP3I_STAT_ADD(dev, lines, 1);
+  dev->oversize = 0;
+  if (dev->ts.enabled) {
+    // The read that completed the line, or that buffered it whole.
+    dev->ts.line_ns = dev->ts.read_ns;
+  }
+  if (predict) {
+    osp3i_predict_line(dev, osp3i_now_ns());
+  }
+  if (OSP3I_PROBE_ENABLED(line)) {
+    OSP3I_PROBE4(line, dev, buf, *transferred, osp3i_now_ns());
+  }
+#ifdef OSP3_LATENCY
+  osp3i_latency_line(dev, first_ns, complete_ns);
+#endif
+  return 0;
+}
+
+int osp3_read_line_resync(osp3_device* dev, unsigned char* buf, size_t len, size_t* transferred, size_t* discarded,
+                          unsigned int timeout_ms) {
+  if (dev == NULL || buf == NULL || transferred == NULL || discarded == NULL || len == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  *discarded = 0;
+  while (1) {
+    // Still discarding an oversize line, possibly from a call that failed partway through it.
+    const int tail = dev->oversize;
+    if (osp3_read_line(dev, buf, len, transferred, timeout_ms) == 0) {
+      if (!tail) {
+        return 0;
+      }
+      // Found the end of an oversize line.
+      OSP3I_STAT_ADD(dev, resyncs, 1);
+    } else if (errno != ENOBUFS) {
+      if (tail) {
+        // Part of the oversize line was read before the error, and is dropped.
+        *discarded += *transferred;
+        OSP3I_STAT_ADD(dev, bytes_discarded, *transferred);
+      }
+      return -1;
+    }
+    *discarded += *transferred;
+    OSP3I_STAT_ADD(dev, bytes_discarded, *transferred);
+  }
+}
+
+int osp3_get_stats(const osp3_device* dev, osp3_stats* stats) {
+  if (dev == NULL || stats == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  stats->bytes_read = atomic_load_explicit(&dev->stats.bytes_read, memory_order_relaxed);
+  stats->reads = atomic_load_explicit(&dev->stats.reads, memory_order_relaxed);
+  stats->timeouts = atomic_load_explicit(&dev->stats.timeouts, memory_order_relaxed);
+  stats->lines = atomic_load_explicit(&dev->stats.lines, memory_order_relaxed);
+  stats->lines_partial = atomic_load_explicit(&dev->stats.lines_partial, memory_order_relaxed);
+  stats->lines_oversize = atomic_load_explicit(&dev->stats.lines_oversize, memory_order_relaxed);
+  stats->resyncs = atomic_load_explicit(&dev->stats.resyncs, memory_order_relaxed);
+  stats->bytes_discarded = atomic_load_explicit(&dev->stats.bytes_discarded, memory_order_relaxed);
+  stats->parse_failures = atomic_load_explicit(&dev->stats.parse_failures, memory_order_relaxed);
+  stats->checksum_failures = atomic_load_explicit(&dev->stats.checksum_failures, memory_order_relaxed);
+  stats->ms_gaps = atomic_load_explicit(&dev->stats.ms_gaps, memory_order_relaxed);
+  stats->ms_resets = atomic_load_explicit(&dev->stats.ms_resets, memory_order_relaxed);
+  stats->parse_failures_overrun = atomic_load_explicit(&dev->stats.parse_failures_overrun, memory_order_relaxed);
+  stats->checksum_failures_overrun = atomic_load_explicit(&dev->stats.checksum_failures_overrun,
+                                                          memory_order_relaxed);
+  osp3i_icount icount;
+  if (dev->stats.icount_supported && dev->transport->icount(dev, &icount) == 0) {
+    stats->overruns = icount.overrun - dev->stats.icount_base.overrun;
+    stats->buf_overruns = icount.buf_overrun - dev->stats.icount_base.buf_overrun;
+    stats->frame_errors = icount.frame - dev->stats.icount_base.frame;
+    stats->parity_errors = icount.parity - dev->stats.icount_base.parity;
+    stats->kernel_counters = 1;
+  } else {
+    stats->overruns = 0;
+    stats->buf_overruns = 0;
+    stats->frame_errors = 0;
+    stats->parity_errors = 0;
+    stats->kernel_counters = 0;
+  }
   return 0;
 }
 
@@ -163,9 +748,25 @@ int osp3_read_line(osp3_device* dev, unsigned char* buf, size_t len, size_t* tra
 static_assert(OSP3_LOG_PAYLOAD_LEN == OSP3_LOG_PROTOCOL_SIZE - 2, "incorrect log field size/index/offset");
 
 static void osp3_log_checksum_compute(const char* log, uint8_t* cs8_2s, uint8_t* cs8_xor) {
-  *cs8_2s = 0;
-  *cs8_xor = 0;
-  for (size_t i = 0; i < CS_2COMPL_OFF; i++) {
+  // Process 8 bytes at a time: XOR is bytewise anyway, and byte sums accumulate in 16-bit lanes without overflow.
+  static const uint64_t lo_bytes = 0x00FF00FF00FF00FFull;
+  uint64_t sum = 0;
+  uint64_t xor = 0;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= CS_2COMPL_OFF; i += sizeof(uint64_t)) {
+    uint64_t w;
+    memcpy(&w, &log[i], sizeof(w));
+    sum += (w & lo_bytes) + ((w >> 8) & lo_bytes);
+    xor ^= w;
+  }
+  sum += (sum >> 32);
+  sum += (sum >> 16);
+  xor ^= (xor >> 32);
+  xor ^= (xor >> 16);
+  xor ^= (xor >> 8);
+  *cs8_2s = (uint8_t) sum;
+  *cs8_xor = (uint8_t) xor;
+  for (; i < CS_2COMPL_OFF; i++) {
     *cs8_2s += (unsigned char) log[i];
     *cs8_xor ^= (unsigned char) log[i];
   }
@@ -192,7 +793,11 @@ int osp3_log_checksum_test(const char* log, size_t log_sz, uint8_t cs8_2s, uint8
   char cs8_xor_log_bytes[8] = { log[CS_XOR_OFF], log[CS_XOR_OFF + 1], '\0' };
   uint8_t cs8_2s_log = (uint8_t) strtoul(cs8_2s_log_bytes, NULL, 16);
   uint8_t cs8_xor_log = (uint8_t) strtoul(cs8_xor_log_bytes, NULL, 16);
-  return !(cs8_2s == cs8_2s_log && cs8_xor == cs8_xor_log);
+  const int ret = !(cs8_2s == cs8_2s_log && cs8_xor == cs8_xor_log);
+  if (OSP3I_PROBE_ENABLED(checksum)) {
+    OSP3I_PROBE3(checksum, log, ret, osp3i_now_ns());
+  }
+  return ret;
 }
 
 int osp3_log_parse(const char* log, size_t log_sz, osp3_log_entry* log_entry) {
@@ -218,5 +823,150 @@ int osp3_log_parse(const char* log, size_t log_sz, osp3_log_entry* log_entry) {
     }
     return -1;
   }
-  return !(matched == 17);
+  const int ret = !(matched == 17);
+  if (OSP3I_PROBE_ENABLED(parse)) {
+    OSP3I_PROBE3(parse, log, ret, osp3i_now_ns());
+  }
+  return ret;
+}
+
+static void log_verify_ms(osp3_device* dev, unsigned long ms) {
+  osp3i_stats* st = &dev->stats;
+  if (st->ms_valid) {
+    if (ms < st->ms_prev) {
+      OSP3I_STAT_ADD(dev, ms_resets, 1);
+    } else if (ms > st->ms_prev) {
+      const unsigned long delta = ms - st->ms_prev;
+      if (st->ms_delta_min == 0 || delta < st->ms_delta_min) {
+        st->ms_delta_min = delta;
+      } else if (2 * delta > 3 * st->ms_delta_min) {
+        OSP3I_STAT_ADD(dev, ms_gaps, 1);
+      }
+    }
+  }
+  st->ms_valid = 1;
+  st->ms_prev = ms;
+}
+
+// Whether the kernel counted overruns since the previous failure was recorded (only checked on failure, to keep a system
+// call off the path for valid lines).
+static int log_verify_overrun(osp3_device* dev) {
+  osp3i_stats* st = &dev->stats;
+  osp3i_icount icount;
+  if (!st->icount_supported || dev->transport->icount(dev, &icount) < 0) {
+    return 0;
+  }
+  const int overrun = icount.overrun != st->icount_last.overrun || icount.buf_overrun != st->icount_last.buf_overrun;
+  st->icount_last = icount;
+  return overrun;
+}
+
+int osp3_log_verify(osp3_device* dev, const char* log, size_t log_sz, osp3_log_entry* log_entry) {
+  uint8_t cs8_2s;
+  uint8_t cs8_xor;
+  int ret = osp3_log_parse(log, log_sz, log_entry);
+  if (ret == 0) {
+    ret = osp3_log_checksum(log, log_sz, &cs8_2s, &cs8_xor);
+    if (ret > 0) {
+      ret = 2;
+    }
+  }
+  if (dev != NULL) {
+    switch (ret) {
+      case 0:
+        log_verify_ms(dev, log_entry->ms);
+        break;
+      case 1:
+        OSP3I_STAT_ADD(dev, parse_failures, 1);
+        if (log_verify_overrun(dev)) {
+          OSP3I_STAT_ADD(dev, parse_failures_overrun, 1);
+        }
+        break;
+      case 2:
+        OSP3I_STAT_ADD(dev, checksum_failures, 1);
+        if (log_verify_overrun(dev)) {
+          OSP3I_STAT_ADD(dev, checksum_failures_overrun, 1);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  if (OSP3I_PROBE_ENABLED(verify)) {
+    OSP3I_PROBE4(verify, dev, ret, ret == 0 ? log_entry->ms : 0, osp3i_now_ns());
+  }
+  return ret;
+}
+
+// Two-digit decimal strings "00" through "99".
+static const char DIGITS_DEC2[] =
+  "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+  "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+static const char DIGITS_HEX[] = "0123456789abcdef";
+
+// Write exactly `width` zero-padded decimal digits (two at a time, right to left) and a trailing comma.
+static void log_format_dec(char* log, unsigned long val, size_t width) {
+  char* p = log + width;
+  *p = ',';
+  for (; width >= 2; width -= 2, val /= 100) {
+    p -= 2;
+    memcpy(p, &DIGITS_DEC2[(val % 100) * 2], 2);
+  }
+  if (width > 0) {
+    *--p = (char) ('0' + val % 10);
+  }
+}
+
+// Write two hexadecimal digits and a trailing comma.
+static void log_format_hex(char* log, unsigned int val) {
+  log[0] = DIGITS_HEX[(val >> 4) & 0xF];
+  log[1] = DIGITS_HEX[val & 0xF];
+  log[2] = ',';
+}
+
+int osp3_log_format(const osp3_log_entry* log_entry, char* log) {
+  if (log_entry == NULL || log == NULL) {
+    errno = EINVAL;
+    return -1;
+  }
+  // Fields must fit their widths, otherwise the device wouldn't have produced them.
+  if (log_entry->ms > 9999999999ul ||
+      log_entry->mV_in > 99999 || log_entry->mA_in > 9999 || log_entry->mW_in > 99999 || log_entry->onoff_in > 9 ||
+      log_entry->mV_0 > 99999 || log_entry->mA_0 > 9999 || log_entry->mW_0 > 99999 || log_entry->onoff_0 > 9 ||
+      log_entry->intr_0 > 0xFF ||
+      log_entry->mV_1 > 99999 || log_entry->mA_1 > 9999 || log_entry->mW_1 > 99999 || log_entry->onoff_1 > 9 ||
+      log_entry->intr_1 > 0xFF) {
+    errno = ERANGE;
+    return -1;
+  }
+  // Time
+  log_format_dec(&log[MS_OFF], log_entry->ms, MS_SZ);
+  // Input Power
+  log_format_dec(&log[MV_IN_OFF], log_entry->mV_in, MV_SZ);
+  log_format_dec(&log[MA_IN_OFF], log_entry->mA_in, MA_SZ);
+  log_format_dec(&log[MW_IN_OFF], log_entry->mW_in, MW_SZ);
+  log_format_dec(&log[ONOFF_IN_OFF], log_entry->onoff_in, ONOFF_SZ);
+  // Channel 0 Output
+  log_format_dec(&log[MV_0_OFF], log_entry->mV_0, MV_SZ);
+  log_format_dec(&log[MA_0_OFF], log_entry->mA_0, MA_SZ);
+  log_format_dec(&log[MW_0_OFF], log_entry->mW_0, MW_SZ);
+  log_format_dec(&log[ONOFF_0_OFF], log_entry->onoff_0, ONOFF_SZ);
+  log_format_hex(&log[INTR_0_OFF], log_entry->intr_0);
+  // Channel 1 Output
+  log_format_dec(&log[MV_1_OFF], log_entry->mV_1, MV_SZ);
+  log_format_dec(&log[MA_1_OFF], log_entry->mA_1, MA_SZ);
+  log_format_dec(&log[MW_1_OFF], log_entry->mW_1, MW_SZ);
+  log_format_dec(&log[ONOFF_1_OFF], log_entry->onoff_1, ONOFF_SZ);
+  log_format_hex(&log[INTR_1_OFF], log_entry->intr_1);
+  // Checksum (the XOR field's trailing comma is overwritten below)
+  uint8_t cs8_2s;
+  uint8_t cs8_xor;
+  osp3_log_checksum_compute(log, &cs8_2s, &cs8_xor);
+  log_format_hex(&log[CS_2COMPL_OFF], cs8_2s);
+  log_format_hex(&log[CS_XOR_OFF], cs8_xor);
+  log[OSP3_LOG_PAYLOAD_LEN] = '\r';
+  log[OSP3_LOG_PAYLOAD_LEN + 1] = '\n';
+  return 0;
 }
@@ -15,6 +15,44 @@
 #include <osp3.h>
 #include "osp3i.h"
 
+uint64_t osp3i_now_ns(void) {
+  return osp3i_clock_ns(CLOCK_MONOTONIC);
+}
+
+uint64_t osp3i_clock_ns(clockid_t clk) {
+  struct timespec ts;
+  clock_gettime(clk, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+void osp3i_sleep_until_ns(uint64_t ns) {
+#ifdef __APPLE__
+  // No clock_nanosleep, so settle for a relative sleep.
+  const uint64_t now = osp3i_now_ns();
+  if (ns > now) {
+    const struct timespec ts = {
+      .tv_sec = (time_t) ((ns - now) / 1000000000ull),
+      .tv_nsec = (long) ((ns - now) % 1000000000ull),
+    };
+    nanosleep(&ts, NULL);
+  }
+#else
+  const struct timespec ts = {
+    .tv_sec = (time_t) (ns / 1000000000ull),
+    .tv_nsec = (long) (ns % 1000000000ull),
+  };
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+#endif
+}
+
+static const osp3i_transport osp3i_transport_serial = {
+  .close = osp3i_close,
+  .flush = osp3i_flush,
+  .read = osp3i_read,
+  .wait = osp3i_wait,
+  .icount = osp3i_serial_icount,
+};
+
 int osp3i_open_path(osp3_device* dev, const char* filename, unsigned int baud) {
   struct stat s;
   if (stat(filename, &s) < 0) {
@@ -31,6 +69,7 @@ int osp3i_open_path(osp3_device* dev, const char* filename, unsigned int baud) {
     close(dev->fd);
     return -1;
   }
+  dev->transport = &osp3i_transport_serial;
   return 0;
 }
 
@@ -42,26 +81,34 @@ int osp3i_flush(osp3_device* dev) {
   return tcflush(dev->fd, TCIFLUSH);
 }
 
-ssize_t osp3i_read(osp3_device* dev, unsigned char* buf, size_t buflen, unsigned int timeout_ms) {
-  ssize_t ret = -1;
+int osp3i_wait_fd(int fd, unsigned int timeout_ms) {
   fd_set set;
   FD_ZERO(&set);
-  FD_SET(dev->fd, &set);
+  FD_SET(fd, &set);
   struct timespec ts_timeout = {
     .tv_sec = timeout_ms / 1000,
     .tv_nsec = (timeout_ms % 1000) * 1000 * 1000,
   };
-  switch (pselect(dev->fd + 1, &set, NULL, NULL, timeout_ms > 0 ? &ts_timeout : NULL, NULL)) {
+  switch (pselect(fd + 1, &set, NULL, NULL, timeout_ms > 0 ? &ts_timeout : NULL, NULL)) {
     case -1:
       // failed
-      break;
+      return -1;
     case 0:
       // timed out
       errno = ETIME;
-      break;
+      return -1;
     default:
-      ret = read(dev->fd, buf, buflen);
-      break;
+      return 0;
+  }
+}
+
+int osp3i_wait(const osp3_device* dev, unsigned int timeout_ms) {
+  return osp3i_wait_fd(dev->fd, timeout_ms);
+}
+
+ssize_t osp3i_read(osp3_device* dev, unsigned char* buf, size_t buflen, unsigned int timeout_ms) {
+  if (osp3i_wait_fd(dev->fd, timeout_ms) < 0) {
+    return -1;
   }
-  return ret;
+  return read(dev->fd, buf, buflen);
 }
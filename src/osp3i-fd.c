@@ -0,0 +1,74 @@
+/**
+ * OSP3 internal interface buffered file descriptor transport.
+ *
+ * Reads from pipes, files, sockets, etc. are made in large blocks, and only wait when the buffer is empty.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <osp3.h>
+#include "osp3i.h"
+
+static int osp3i_fd_close(osp3_device* dev) {
+  // The file descriptor belongs to the caller, as does the buffer if it was provided.
+  if (!dev->fdbuf.external) {
+    free(dev->fdbuf.buf);
+  }
+  return 0;
+}
+
+static int osp3i_fd_flush(osp3_device* dev) {
+  dev->fdbuf.idx = 0;
+  dev->fdbuf.rem = 0;
+  return 0;
+}
+
+static ssize_t osp3i_fd_read(osp3_device* dev, unsigned char* buf, size_t buflen, unsigned int timeout_ms) {
+  osp3i_fdbuf* fb = &dev->fdbuf;
+  if (fb->rem == 0) {
+    ssize_t bytes_read;
+    if (osp3i_wait_fd(dev->fd, timeout_ms) < 0) {
+      return -1;
+    }
+    while ((bytes_read = read(dev->fd, fb->buf, fb->cap)) < 0 && errno == EINTR);
+    if (bytes_read <= 0) {
+      return bytes_read;
+    }
+    fb->idx = 0;
+    fb->rem = (size_t) bytes_read;
+  }
+  const size_t n = fb->rem < buflen ? fb->rem : buflen;
+  memcpy(buf, &fb->buf[fb->idx], n);
+  fb->idx += n;
+  fb->rem -= n;
+  return (ssize_t) n;
+}
+
+static int osp3i_fd_wait(const osp3_device* dev, unsigned int timeout_ms) {
+  return dev->fdbuf.rem > 0 ? 0 : osp3i_wait_fd(dev->fd, timeout_ms);
+}
+
+static const osp3i_transport osp3i_transport_fd = {
+  .close = osp3i_fd_close,
+  .flush = osp3i_fd_flush,
+  .read = osp3i_fd_read,
+  .wait = osp3i_fd_wait,
+  .icount = NULL,
+};
+
+int osp3i_open_fd(osp3_device* dev, int fd, unsigned char* buf, size_t buf_size) {
+  dev->fdbuf.external = buf != NULL;
+  if ((dev->fdbuf.buf = buf) == NULL && (dev->fdbuf.buf = malloc(buf_size)) == NULL) {
+    return -1;
+  }
+  dev->fdbuf.cap = buf_size;
+  dev->fdbuf.idx = 0;
+  dev->fdbuf.rem = 0;
+  dev->fd = fd;
+  dev->transport = &osp3i_transport_fd;
+  return 0;
+}
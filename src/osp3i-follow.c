@@ -0,0 +1,243 @@
+/**
+ * OSP3 internal interface file follow transport.
+ *
+ * Follows a growing file (e.g., a log being captured by another process), like `tail -F`.
+ * At the end of the file, reads wait for inotify events instead of polling, then check whether the file was truncated
+ * or replaced (rotated) before reading more.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <osp3.h>
+#include "osp3i.h"
+
+#ifdef __linux__
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+// Modifications and metadata changes (e.g., truncation) to the file, or the file being moved or deleted.
+#define FOLLOW_FILE_EVENTS (IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF)
+// A file being created or moved into the directory, e.g., a new file after rotation.
+#define FOLLOW_DIR_EVENTS (IN_CREATE | IN_MOVED_TO)
+
+static int follow_watch(osp3_device* dev) {
+  osp3i_follow* fl = &dev->follow;
+  struct stat s;
+  if (fstat(dev->fd, &s) < 0) {
+    return -1;
+  }
+  if (fl->wd_file >= 0) {
+    // Fails if the old file was deleted, which already removed the watch.
+    inotify_rm_watch(fl->ifd, fl->wd_file);
+  }
+  if ((fl->wd_file = inotify_add_watch(fl->ifd, fl->path, FOLLOW_FILE_EVENTS)) < 0) {
+    return -1;
+  }
+  fl->st_dev = s.st_dev;
+  fl->st_ino = s.st_ino;
+  fl->offset = 0;
+  return 0;
+}
+
+// Returns 1 if the path now refers to a different file than the one being read.
+static int follow_replaced(const osp3_device* dev) {
+  struct stat s;
+  // A missing file may be recreated later.
+  return stat(dev->follow.path, &s) == 0 && (s.st_dev != dev->follow.st_dev || s.st_ino != dev->follow.st_ino);
+}
+
+// At the end of the file, reopen a replaced file or rewind a truncated one.
+// Returns 1 if there may be more to read, 0 if not.
+static int follow_check(osp3_device* dev) {
+  osp3i_follow* fl = &dev->follow;
+  struct stat s;
+  int fd;
+  if (follow_replaced(dev)) {
+    // Anything written to the old file after this point is lost, as with `tail -F`.
+    if ((fd = open(fl->path, O_RDONLY | O_CLOEXEC)) < 0) {
+      // Replaced again already, or not readable - try again after the next event.
+      return 0;
+    }
+    close(dev->fd);
+    dev->fd = fd;
+    if (follow_watch(dev) < 0) {
+      return -1;
+    }
+    return 1;
+  }
+  if (fstat(dev->fd, &s) < 0) {
+    return -1;
+  }
+  if (s.st_size < fl->offset) {
+    if (lseek(dev->fd, 0, SEEK_SET) < 0) {
+      return -1;
+    }
+    fl->offset = 0;
+    return 1;
+  }
+  return s.st_size > fl->offset;
+}
+
+// Wait for (and discard) inotify events until the deadline (0 to wait indefinitely).
+static int follow_wait_event(const osp3_device* dev, uint64_t deadline_ns) {
+  char events[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  unsigned int timeout_ms = 0;
+  if (deadline_ns > 0) {
+    const uint64_t now = osp3i_now_ns();
+    if (now >= deadline_ns) {
+      errno = ETIME;
+      return -1;
+    }
+    // Round up, so a short remainder doesn't become an indefinite wait.
+    timeout_ms = (unsigned int) ((deadline_ns - now + 999999) / 1000000);
+  }
+  if (osp3i_wait_fd(dev->follow.ifd, timeout_ms) < 0) {
+    return -1;
+  }
+  // Only the wakeup matters, not which event caused it.
+  while (read(dev->follow.ifd, events, sizeof(events)) > 0);
+  return errno == EAGAIN || errno == EINTR ? 0 : -1;
+}
+
+static int osp3i_follow_close(osp3_device* dev) {
+  int ret = close(dev->follow.ifd);
+  if (close(dev->fd) < 0) {
+    ret = -1;
+  }
+  free(dev->follow.path);
+  free(dev->fdbuf.buf);
+  return ret;
+}
+
+static int osp3i_follow_flush(osp3_device* dev) {
+  dev->fdbuf.idx = 0;
+  dev->fdbuf.rem = 0;
+  return 0;
+}
+
+static ssize_t osp3i_follow_read(osp3_device* dev, unsigned char* buf, size_t buflen, unsigned int timeout_ms) {
+  osp3i_fdbuf* fb = &dev->fdbuf;
+  const uint64_t deadline_ns = timeout_ms > 0 ? osp3i_now_ns() + timeout_ms * 1000000ull : 0;
+  while (fb->rem == 0) {
+    ssize_t bytes_read;
+    while ((bytes_read = read(dev->fd, fb->buf, fb->cap)) < 0 && errno == EINTR);
+    if (bytes_read < 0) {
+      return -1;
+    }
+    if (bytes_read > 0) {
+      dev->follow.offset += bytes_read;
+      fb->idx = 0;
+      fb->rem = (size_t) bytes_read;
+      break;
+    }
+    const int more = follow_check(dev);
+    if (more < 0 || (more == 0 && follow_wait_event(dev, deadline_ns) < 0)) {
+      return -1;
+    }
+  }
+  const size_t n = fb->rem < buflen ? fb->rem : buflen;
+  memcpy(buf, &fb->buf[fb->idx], n);
+  fb->idx += n;
+  fb->rem -= n;
+  return (ssize_t) n;
+}
+
+static int osp3i_follow_wait(const osp3_device* dev, unsigned int timeout_ms) {
+  const uint64_t deadline_ns = timeout_ms > 0 ? osp3i_now_ns() + timeout_ms * 1000000ull : 0;
+  struct stat s;
+  while (dev->fdbuf.rem == 0) {
+    if (fstat(dev->fd, &s) < 0) {
+      return -1;
+    }
+    // Truncation also needs attention from the next read.
+    if (s.st_size != dev->follow.offset || follow_replaced(dev)) {
+      break;
+    }
+    if (follow_wait_event(dev, deadline_ns) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static const osp3i_transport osp3i_transport_follow = {
+  .close = osp3i_follow_close,
+  .flush = osp3i_follow_flush,
+  .read = osp3i_follow_read,
+  .wait = osp3i_follow_wait,
+  .icount = NULL,
+};
+
+int osp3i_open_follow(osp3_device* dev, const char* path, int seek_end, size_t buf_size) {
+  osp3i_follow* fl = &dev->follow;
+  char dir[PATH_MAX];
+  off_t offset = 0;
+  const char* slash = strrchr(path, '/');
+  if (slash == NULL) {
+    strcpy(dir, ".");
+  } else if ((size_t) (slash - path) < sizeof(dir)) {
+    // Keep the slash if the file is in the root directory.
+    const size_t len = slash == path ? 1 : (size_t) (slash - path);
+    memcpy(dir, path, len);
+    dir[len] = '\0';
+  } else {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  fl->wd_file = -1;
+  if ((fl->path = strdup(path)) == NULL) {
+    return -1;
+  }
+  if ((dev->fdbuf.buf = malloc(buf_size)) == NULL) {
+    goto fail_path;
+  }
+  if ((dev->fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+    goto fail_buf;
+  }
+  if ((fl->ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+    goto fail_fd;
+  }
+  if (inotify_add_watch(fl->ifd, dir, FOLLOW_DIR_EVENTS) < 0 || follow_watch(dev) < 0) {
+    goto fail_ifd;
+  }
+  if (seek_end && (offset = lseek(dev->fd, 0, SEEK_END)) < 0) {
+    goto fail_ifd;
+  }
+  fl->offset = offset;
+  dev->fdbuf.cap = buf_size;
+  dev->fdbuf.idx = 0;
+  dev->fdbuf.rem = 0;
+  dev->transport = &osp3i_transport_follow;
+  return 0;
+
+fail_ifd:
+  close(fl->ifd);
+fail_fd:
+  close(dev->fd);
+fail_buf:
+  free(dev->fdbuf.buf);
+fail_path:
+  free(fl->path);
+  return -1;
+}
+
+#else
+
+int osp3i_open_follow(osp3_device* dev, const char* path, int seek_end, size_t buf_size) {
+  (void) dev;
+  (void) path;
+  (void) seek_end;
+  (void) buf_size;
+  // Following without inotify would require polling.
+  errno = ENOTSUP;
+  return -1;
+}
+
+#endif
@@ -0,0 +1,63 @@
+/**
+ * OSP3 internal interface in-memory transport.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <errno.h>
+#include <string.h>
+#include <osp3.h>
+#include "osp3i.h"
+
+static int osp3i_mem_close(osp3_device* dev) {
+  (void) dev;
+  return 0;
+}
+
+static int osp3i_mem_flush(osp3_device* dev) {
+  // Data is never received ahead of being read, so there's nothing to drop.
+  (void) dev;
+  return 0;
+}
+
+static ssize_t osp3i_mem_read(osp3_device* dev, unsigned char* buf, size_t buflen, unsigned int timeout_ms) {
+  // Never blocks.
+  (void) timeout_ms;
+  size_t n = dev->mem.len - dev->mem.off;
+  if (n > dev->mem.packet_size) {
+    n = dev->mem.packet_size;
+  }
+  if (n > buflen) {
+    n = buflen;
+  }
+  if (n == 0) {
+    return 0;
+  }
+  memcpy(buf, &dev->mem.buf[dev->mem.off], n);
+  dev->mem.off += n;
+  return (ssize_t) n;
+}
+
+static int osp3i_mem_wait(const osp3_device* dev, unsigned int timeout_ms) {
+  (void) dev;
+  (void) timeout_ms;
+  return 0;
+}
+
+static const osp3i_transport osp3i_transport_mem = {
+  .close = osp3i_mem_close,
+  .flush = osp3i_mem_flush,
+  .read = osp3i_mem_read,
+  .wait = osp3i_mem_wait,
+  .icount = NULL,
+};
+
+int osp3i_open_mem(osp3_device* dev, const void* buf, size_t len, size_t packet_size) {
+  dev->mem.buf = buf;
+  dev->mem.len = len;
+  dev->mem.off = 0;
+  dev->mem.packet_size = packet_size > 0 ? packet_size : OSP3_W_MAX_PACKET_SIZE;
+  dev->fd = -1;
+  dev->transport = &osp3i_transport_mem;
+  return 0;
+}
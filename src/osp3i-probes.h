@@ -0,0 +1,49 @@
+/**
+ * OSP3 USDT (user statically-defined tracing) probes, for tools like bpftrace and perf.
+ *
+ * Probes are compiled in only when `OSP3_USDT` is defined (i.e., sys/sdt.h is available).
+ * Each probe has a semaphore that's non-zero only while a tracer is attached, so probe arguments that are costly to
+ * compute (like timestamps) should be guarded by `OSP3I_PROBE_ENABLED`.
+ * When compiled out, probes and their arguments vanish entirely.
+ *
+ * Probes (provider "osp3"):
+ *   read_start(dev, len, ts_ns)
+ *   read_end(dev, bytes_read, errno, ts_ns)    bytes_read is -1 on error, 0 at the end of data
+ *   line(dev, buf, transferred, ts_ns)
+ *   parse(log, ret, ts_ns)
+ *   checksum(log, ret, ts_ns)
+ *   verify(dev, ret, ms, ts_ns)
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#ifndef _OSP3I_PROBES_
+#define _OSP3I_PROBES_
+
+#ifdef OSP3_USDT
+
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+
+#pragma GCC visibility push(hidden)
+extern volatile unsigned short osp3_read_start_semaphore;
+extern volatile unsigned short osp3_read_end_semaphore;
+extern volatile unsigned short osp3_line_semaphore;
+extern volatile unsigned short osp3_parse_semaphore;
+extern volatile unsigned short osp3_checksum_semaphore;
+extern volatile unsigned short osp3_verify_semaphore;
+#pragma GCC visibility pop
+
+#define OSP3I_PROBE_ENABLED(name) __builtin_expect(osp3_##name##_semaphore != 0, 0)
+#define OSP3I_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(osp3, name, a1, a2, a3)
+#define OSP3I_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(osp3, name, a1, a2, a3, a4)
+
+#else
+
+#define OSP3I_PROBE_ENABLED(name) 0
+#define OSP3I_PROBE3(name, a1, a2, a3) do { } while (0)
+#define OSP3I_PROBE4(name, a1, a2, a3, a4) do { } while (0)
+
+#endif
+
+#endif
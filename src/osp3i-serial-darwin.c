@@ -56,3 +56,10 @@ int osp3i_serial_configure(osp3_device* dev, unsigned int baud) {
   }
   return 0;
 }
+
+int osp3i_serial_icount(const osp3_device* dev, osp3i_icount* icount) {
+  (void) dev;
+  (void) icount;
+  errno = ENOTSUP;
+  return -1;
+}
@@ -6,6 +6,10 @@
  */
 #include <errno.h>
 #include <termios.h>
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+#endif
 #include <osp3.h>
 #include "osp3i.h"
 
@@ -75,3 +79,23 @@ int osp3i_serial_configure(osp3_device* dev, unsigned int baud) {
   }
   return 0;
 }
+
+int osp3i_serial_icount(const osp3_device* dev, osp3i_icount* icount) {
+#if defined(__linux__) && defined(TIOCGICOUNT)
+  struct serial_icounter_struct ic;
+  if (ioctl(dev->fd, TIOCGICOUNT, &ic) < 0) {
+    // E.g., pseudo-terminals and USB serial drivers that don't keep counters.
+    return -1;
+  }
+  icount->overrun = (uint32_t) ic.overrun;
+  icount->buf_overrun = (uint32_t) ic.buf_overrun;
+  icount->frame = (uint32_t) ic.frame;
+  icount->parity = (uint32_t) ic.parity;
+  return 0;
+#else
+  (void) dev;
+  (void) icount;
+  errno = ENOTSUP;
+  return -1;
+#endif
+}
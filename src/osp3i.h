@@ -9,22 +9,265 @@
 #ifndef _OSP3I_
 #define _OSP3I_
 
+#include <stdatomic.h>
 #include <sys/types.h>
 #include <osp3.h>
 
 #pragma GCC visibility push(hidden)
 
+// Room for more than a line, so a line can be read with one call when it's known to be complete (see `osp3i_predict`).
+#define OSP3I_RBUF_SIZE (2 * OSP3_W_MAX_PACKET_SIZE)
+
 typedef struct osp3_rw_buffer {
-  unsigned char buf[OSP3_W_MAX_PACKET_SIZE];
+  unsigned char buf[OSP3I_RBUF_SIZE];
   size_t idx;
   size_t rem;
 } osp3_rw_buffer;
 
+/**
+ * Kernel serial driver error counters.
+ */
+typedef struct osp3i_icount {
+  // Kernel counters wrap, so deltas are computed in 32-bit unsigned arithmetic.
+  uint32_t overrun;
+  uint32_t buf_overrun;
+  uint32_t frame;
+  uint32_t parity;
+} osp3i_icount;
+
+/**
+ * A data source backing a device.
+ * A `read` that returns 0 bytes (without error) indicates the end of the data.
+ * `wait` returns 0 when a `read` wouldn't block (including at the end of the data).
+ * `icount` may be NULL if the transport has no kernel error counters.
+ */
+typedef struct osp3i_transport {
+  int (*close)(osp3_device* dev);
+  int (*flush)(osp3_device* dev);
+  ssize_t (*read)(osp3_device* dev, unsigned char* buf, size_t buflen, unsigned int timeout_ms);
+  int (*wait)(const osp3_device* dev, unsigned int timeout_ms);
+  int (*icount)(const osp3_device* dev, osp3i_icount* icount);
+} osp3i_transport;
+
+typedef struct osp3i_fdbuf {
+  unsigned char* buf;
+  // The buffer was provided by the caller (see `osp3_open_fd_into`), so isn't freed.
+  int external;
+  size_t cap;
+  size_t idx;
+  size_t rem;
+} osp3i_fdbuf;
+
+typedef struct osp3i_follow {
+  char* path;
+  int ifd;
+  int wd_file;
+  // The file being read, and the read offset (buffered data has already been read).
+  dev_t st_dev;
+  ino_t st_ino;
+  off_t offset;
+} osp3i_follow;
+
+typedef struct osp3i_mem {
+  const unsigned char* buf;
+  size_t len;
+  size_t off;
+  size_t packet_size;
+} osp3i_mem;
+
+// Counters have a single writer (the reading thread), so relaxed loads and stores suffice - no atomic read-modify-write.
+typedef struct osp3i_stats {
+  _Atomic uint64_t bytes_read;
+  _Atomic uint64_t reads;
+  _Atomic uint64_t timeouts;
+  _Atomic uint64_t lines;
+  _Atomic uint64_t lines_partial;
+  _Atomic uint64_t lines_oversize;
+  _Atomic uint64_t resyncs;
+  _Atomic uint64_t bytes_discarded;
+  _Atomic uint64_t parse_failures;
+  _Atomic uint64_t checksum_failures;
+  _Atomic uint64_t ms_gaps;
+  _Atomic uint64_t ms_resets;
+  _Atomic uint64_t parse_failures_overrun;
+  _Atomic uint64_t checksum_failures_overrun;
+  // Timestamp tracking, owned by the reading thread.
+  int ms_valid;
+  unsigned long ms_prev;
+  unsigned long ms_delta_min;
+  // Kernel error counters when the device was opened, and as of the last recorded failure (owned by the reading thread).
+  int icount_supported;
+  osp3i_icount icount_base;
+  osp3i_icount icount_last;
+} osp3i_stats;
+
+#define OSP3I_STAT_ADD(dev, field, n) \
+  atomic_store_explicit(&(dev)->stats.field, \
+                        atomic_load_explicit(&(dev)->stats.field, memory_order_relaxed) + (n), memory_order_relaxed)
+
+#define OSP3I_PREDICT_LEARN_LINES 8
+
+// Line arrival prediction state, owned by the reading thread.
+typedef struct osp3i_predict {
+  int enabled;
+  // Learning the period.
+  uint64_t deltas[OSP3I_PREDICT_LEARN_LINES];
+  unsigned int ndeltas;
+  // When the previous line completed.
+  uint64_t last_ns;
+  // The model - a period of 0 means it's still learning.
+  uint64_t period_ns;
+  // When the next line is expected to be complete.
+  uint64_t expect_ns;
+  // When reading started (after any sleep).
+  uint64_t read_ns;
+  // Consecutive lines already complete on waking, and how far to move the expected time earlier for each.
+  unsigned long complete_run;
+  uint64_t nudge_ns;
+} osp3i_predict;
+
+void osp3i_predict_reset(osp3_device* dev);
+
+/**
+ * Sleep until the next line is expected to be complete (without exceeding `timeout_ms`, if not 0).
+ */
+void osp3i_predict_sleep(osp3_device* dev, unsigned int timeout_ms);
+
+/**
+ * Update the model with a line's completion time.
+ */
+void osp3i_predict_line(osp3_device* dev, uint64_t complete_ns);
+
+// Batched reads, owned by the reading thread.
+typedef struct osp3i_coalesce {
+  // NULL when not coalescing.
+  unsigned char* buf;
+  size_t cap;
+  // A buffer in caller-provided storage, if any, used instead of allocating one.
+  unsigned char* storage_buf;
+  // The buffer size to use, or 0 for the default.
+  size_t buf_size;
+  size_t idx;
+  size_t rem;
+  uint64_t max_ns;
+  // When the next batch is due.
+  uint64_t next_ns;
+  // The last read filled the buffer, so more data is probably waiting.
+  int more;
+} osp3i_coalesce;
+
+// Line timestamps, owned by the reading thread.
+typedef struct osp3i_timestamp {
+  int enabled;
+  clockid_t clk;
+  // When data was last read, and when the most recent line was completed.
+  uint64_t read_ns;
+  uint64_t line_ns;
+} osp3i_timestamp;
+
+// Resource usage sampled when self stats were reset.
+typedef struct osp3i_self {
+  int started;
+  osp3_self_scope scope;
+  osp3_self_stats base;
+} osp3i_self;
+
+// Memory locked by `osp3_set_realtime`, owned by the reading thread.
+typedef struct osp3i_realtime {
+  int locked;
+} osp3i_realtime;
+
+/**
+ * Lock a buffer in memory if the device's memory is locked, or unlock all the device's memory.
+ */
+int osp3i_realtime_lock(osp3_device* dev, void* addr, size_t len);
+
+void osp3i_realtime_unlock(osp3_device* dev);
+
+#ifdef OSP3_LATENCY
+// Log-linear histogram: 16 linear sub-buckets per power of 2, up to 2^40 ns (~18 minutes).
+#define OSP3I_LATENCY_SUB_BITS 4
+#define OSP3I_LATENCY_EXP_MAX 40
+#define OSP3I_LATENCY_BUCKETS ((OSP3I_LATENCY_EXP_MAX - OSP3I_LATENCY_SUB_BITS + 2) << OSP3I_LATENCY_SUB_BITS)
+
+typedef struct osp3i_latency_hist {
+  _Atomic uint64_t buckets[OSP3I_LATENCY_BUCKETS];
+  _Atomic uint64_t max_ns;
+} osp3i_latency_hist;
+
+typedef struct osp3i_latency {
+  osp3i_latency_hist hist[OSP3_LATENCY_STAGE_COUNT];
+  // When the data in the read buffer was read.
+  uint64_t rbuf_ns;
+  // The most recent line, owned by the reading thread.
+  uint64_t first_ns;
+  uint64_t complete_ns;
+  uint64_t parsed_ns;
+  int parsed;
+  int delivered;
+} osp3i_latency;
+
+void osp3i_latency_line(osp3_device* dev, uint64_t first_ns, uint64_t complete_ns);
+#endif
+
 struct osp3_device {
   osp3_rw_buffer rbuf;
+  // In caller-provided storage, so not freed.
+  int storage;
+  const osp3i_transport* transport;
   int fd;
+  osp3i_mem mem;
+  osp3i_fdbuf fdbuf;
+  osp3i_follow follow;
+  osp3i_stats stats;
+  osp3i_predict pred;
+  osp3i_coalesce coal;
+  osp3i_timestamp ts;
+  // Discard data through the first newline after opening or flushing (see `OSP3_OPEN_SKIP_PARTIAL`).
+  int skip_partial;
+  int skip_pending;
+  // The line being read didn't fit in the caller's buffer, so its remainder is still unread (kept across errors).
+  int oversize;
+  osp3i_self self;
+  osp3i_realtime rt;
+#ifdef OSP3_LATENCY
+  osp3i_latency lat;
+#endif
 };
 
+/**
+ * Allocate a zeroed device, aligned to `OSP3_DEVICE_ALIGN`.
+ */
+osp3_device* osp3i_device_new(void);
+
+/**
+ * Free a device, unless it's in caller-provided storage.
+ */
+void osp3i_device_free(osp3_device* dev);
+
+/**
+ * Get the current CLOCK_MONOTONIC time in nanoseconds.
+ */
+uint64_t osp3i_now_ns(void);
+
+/**
+ * Get the current time of a clock in nanoseconds.
+ */
+uint64_t osp3i_clock_ns(clockid_t clk);
+
+/**
+ * Sleep until a CLOCK_MONOTONIC time in nanoseconds (or until interrupted by a signal).
+ */
+void osp3i_sleep_until_ns(uint64_t ns);
+
+/**
+ * Wait up to `timeout_ms` (or indefinitely if 0) for a file descriptor to be readable (errno is set to ETIME on timeout).
+ */
+int osp3i_wait_fd(int fd, unsigned int timeout_ms);
+
+/**
+ * Serial port transport.
+ */
 int osp3i_open_path(osp3_device* dev, const char* filename, unsigned int baud);
 
 int osp3i_close(osp3_device* dev);
@@ -33,11 +276,33 @@ int osp3i_flush(osp3_device* dev);
 
 ssize_t osp3i_read(osp3_device* dev, unsigned char* buf, size_t buflen, unsigned int timeout_ms);
 
+int osp3i_wait(const osp3_device* dev, unsigned int timeout_ms);
+
+/**
+ * In-memory transport.
+ */
+int osp3i_open_mem(osp3_device* dev, const void* buf, size_t len, size_t packet_size);
+
+/**
+ * Buffered file descriptor transport, using `buf` if not NULL, or else allocating a buffer.
+ */
+int osp3i_open_fd(osp3_device* dev, int fd, unsigned char* buf, size_t buf_size);
+
+/**
+ * File follow transport, using the fd transport's buffer (Linux only - errno is set to ENOTSUP elsewhere).
+ */
+int osp3i_open_follow(osp3_device* dev, const char* path, int seek_end, size_t buf_size);
+
 /**
  * Darwin (macOS) doesn't support all the necessary POSIX baud rates, so it uses a different implementation.
  */
 int osp3i_serial_configure(osp3_device* dev, unsigned int baud);
 
+/**
+ * Kernel serial driver error counters are only available on Linux (errno is set to ENOTSUP elsewhere).
+ */
+int osp3i_serial_icount(const osp3_device* dev, osp3i_icount* icount);
+
 #pragma GCC visibility pop
 
 #endif
@@ -0,0 +1,173 @@
+#undef NDEBUG
+#ifdef __linux__
+// For sched_getcpu.
+#define _GNU_SOURCE
+#include <sched.h>
+#endif
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <osp3.h>
+
+#define LINES 1000
+#define LINES_WARMUP 10
+
+// Count allocations by replacing the allocator, which glibc supports (including for its own internal allocations).
+#ifdef __GLIBC__
+#define ALLOCS_COUNTED 1
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+static int counting = 0;
+static unsigned long allocs = 0;
+
+void* malloc(size_t size) {
+  allocs += (unsigned long) counting;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+  allocs += (unsigned long) counting;
+  return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  allocs += (unsigned long) counting;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+  // Anything freed was allocated at some point, so freeing in the steady state is just as suspect.
+  allocs += (unsigned long) (counting && ptr != NULL);
+  __libc_free(ptr);
+}
+#else
+#define ALLOCS_COUNTED 0
+static int counting = 0;
+static unsigned long allocs = 0;
+#endif
+
+static long minor_faults(void) {
+  struct rusage ru;
+  assert(getrusage(RUSAGE_SELF, &ru) == 0);
+  return ru.ru_minflt;
+}
+
+static void test_osp3_set_realtime_bad(void) {
+  const osp3_realtime rt = { .cpu = -1, .fifo_priority = 0, .lock_memory = 0 };
+  osp3_realtime rt_bad = rt;
+  osp3_device* dev;
+  errno = 0;
+  assert(osp3_set_realtime(NULL, &rt) == -1);
+  assert(errno == EINVAL);
+  assert((dev = osp3_open_mem(NULL, 0, 0)) != NULL);
+  errno = 0;
+  assert(osp3_set_realtime(dev, NULL) == -1);
+  assert(errno == EINVAL);
+  rt_bad.cpu = -2;
+  errno = 0;
+  assert(osp3_set_realtime(dev, &rt_bad) == -1);
+  assert(errno == EINVAL);
+  rt_bad = rt;
+  rt_bad.fifo_priority = -1;
+  errno = 0;
+  assert(osp3_set_realtime(dev, &rt_bad) == -1);
+  assert(errno == EINVAL);
+  // Nothing to change.
+  assert(osp3_set_realtime(dev, &rt) == 0);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_read_line_realtime(void) {
+  osp3_realtime rt = { .cpu = -1, .fifo_priority = 0, .lock_memory = 1 };
+  osp3_log_entry entry;
+  osp3_device* dev;
+  unsigned char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+  size_t transferred;
+  char* data;
+  assert((data = malloc(LINES * OSP3_LOG_PROTOCOL_SIZE)) != NULL);
+  memset(&entry, 0, sizeof(entry));
+  for (unsigned long i = 0; i < LINES; i++) {
+    entry.ms = i;
+    entry.mV_in = 15000;
+    assert(osp3_log_format(&entry, &data[i * OSP3_LOG_PROTOCOL_SIZE]) == 0);
+  }
+  // Device-sized packets, so lines straddle reads as they do from the device.
+  assert((dev = osp3_open_mem(data, LINES * OSP3_LOG_PROTOCOL_SIZE, OSP3_W_MAX_PACKET_SIZE)) != NULL);
+#ifdef __linux__
+  // Pin to wherever this thread is already running, which the environment must allow.
+  rt.cpu = sched_getcpu();
+  assert(rt.cpu >= 0);
+#else
+  rt.cpu = -1;
+#endif
+  if (osp3_set_realtime(dev, &rt) < 0) {
+    // RLIMIT_MEMLOCK may be too small in some environments.
+    assert(errno == ENOMEM || errno == EPERM);
+    fprintf(stderr, "Skipping memory locking: %s\n", strerror(errno));
+    rt.lock_memory = 0;
+    assert(osp3_set_realtime(dev, &rt) == 0);
+  }
+  for (unsigned long i = 0; i < LINES; i++) {
+    if (i == LINES_WARMUP) {
+      counting = 1;
+    }
+    const long faults = minor_faults();
+    assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, 0) == 0);
+    assert(osp3_log_verify(dev, (const char*) line, transferred, &entry) == 0);
+    assert(entry.ms == i);
+    if (counting && rt.lock_memory) {
+      assert(minor_faults() == faults);
+    }
+  }
+  counting = 0;
+  printf("Steady-state allocations: %lu%s\n", allocs, ALLOCS_COUNTED ? "" : " (not counted)");
+  assert(allocs == 0);
+  assert(osp3_close(dev) == 0);
+  free(data);
+}
+
+static void test_osp3_lifecycle_storage(void) {
+  static char data[LINES * OSP3_LOG_PROTOCOL_SIZE];
+  const osp3_buffer_opts opts = { .fd_buf_size = 0, .coalesce_buf_size = OSP3_COALESCE_BUF_SIZE_DEFAULT };
+  osp3_log_entry entry;
+  osp3_device* dev;
+  unsigned char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+  size_t transferred;
+  // Sized at runtime, since the device's size depends on the build configuration (e.g., OSP3_LATENCY).
+  const size_t storage_size = osp3_device_size(&opts);
+  void* storage;
+  assert((storage = aligned_alloc(OSP3_DEVICE_ALIGN, storage_size)) != NULL);
+  memset(&entry, 0, sizeof(entry));
+  for (unsigned long i = 0; i < LINES; i++) {
+    entry.ms = i;
+    assert(osp3_log_format(&entry, &data[i * OSP3_LOG_PROTOCOL_SIZE]) == 0);
+  }
+  // Opening, coalescing, reading, and closing all use the caller's storage.
+  allocs = 0;
+  counting = 1;
+  assert((dev = osp3_open_mem_into(storage, storage_size, &opts, data, sizeof(data), 0)) != NULL);
+  assert(osp3_set_coalesce(dev, 1) == 0);
+  for (unsigned long i = 0; i < LINES; i++) {
+    assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, 0) == 0);
+    assert(osp3_log_verify(dev, (const char*) line, transferred, &entry) == 0);
+    assert(entry.ms == i);
+  }
+  assert(osp3_close(dev) == 0);
+  counting = 0;
+  printf("Lifecycle allocations: %lu%s\n", allocs, ALLOCS_COUNTED ? "" : " (not counted)");
+  assert(allocs == 0);
+  free(storage);
+}
+
+int main(void) {
+  test_osp3_set_realtime_bad();
+  test_osp3_read_line_realtime();
+  test_osp3_lifecycle_storage();
+  return 0;
+}
@@ -0,0 +1,451 @@
+#undef NDEBUG
+#ifdef __linux__
+// For RUSAGE_THREAD.
+#define _GNU_SOURCE
+#endif
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <osp3.h>
+#include "osp3sim.h"
+
+#define READ_TIMEOUT_MS 1000
+
+// The fraction of intact lines that must be recovered despite injected faults.
+#define RECOVERY_RATE_MIN 0.98
+
+static void test_osp3sim_gen(void) {
+  osp3sim_config cfg;
+  osp3sim_gen gen;
+  osp3_log_entry entry;
+  osp3_log_entry parsed;
+  char line[OSP3_LOG_PROTOCOL_SIZE + 1] = { 0 };
+  uint8_t cs8_2s;
+  uint8_t cs8_xor;
+  // Generated entries are within the protocol's limits and round-trip through the parser, for every waveform.
+  for (int w = OSP3SIM_WAVEFORM_CONSTANT; w <= OSP3SIM_WAVEFORM_IDLE; w++) {
+    osp3sim_config_init(&cfg);
+    cfg.waveform = (osp3sim_waveform) w;
+    osp3sim_gen_init(&gen, &cfg);
+    for (int i = 0; i < 1000; i++) {
+      osp3sim_gen_next(&gen, &entry);
+      assert(osp3_log_format(&entry, line) == 0);
+      assert(osp3_log_parse(line, sizeof(line), &parsed) == 0);
+      assert(osp3_log_checksum(line, sizeof(line), &cs8_2s, &cs8_xor) == 0);
+      assert(parsed.ms == entry.ms);
+      assert(parsed.mW_0 == entry.mW_0);
+      assert(parsed.mA_in == entry.mA_in);
+    }
+  }
+}
+
+static void test_osp3_open_path_bad_baud(void) {
+  osp3sim* sim = osp3sim_open(NULL);
+  assert(sim != NULL);
+  errno = 0;
+  assert(osp3_open_path(osp3sim_path(sim), 12345) == NULL);
+  assert(errno == EINVAL);
+  assert(osp3sim_close(sim) == 0);
+}
+
+static void test_osp3_open_path_not_tty(void) {
+  errno = 0;
+  assert(osp3_open_path("/", 0) == NULL);
+  assert(errno == ENOTTY);
+}
+
+static void test_osp3_read_line_sim(unsigned int interval_ms, unsigned int baud, size_t packet_size) {
+  osp3sim_config cfg;
+  osp3sim* sim;
+  osp3_device* dev;
+  osp3_log_entry entry;
+  unsigned char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+  size_t transferred;
+  const unsigned long count = 50;
+  osp3sim_config_init(&cfg);
+  cfg.interval_ms = interval_ms;
+  cfg.baud = baud;
+  cfg.packet_size = packet_size;
+  cfg.count = count;
+  cfg.ms_start = 1000;
+  assert((sim = osp3sim_open(&cfg)) != NULL);
+  assert((dev = osp3_open_path(osp3sim_path(sim), baud)) != NULL);
+  assert(osp3sim_start(sim) == 0);
+  const unsigned int ms_step = interval_ms > 0 ? interval_ms : OSP3_INTERVAL_MS_MIN;
+  for (unsigned long i = 0; i < count; i++) {
+    memset(line, 0, sizeof(line));
+    assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, READ_TIMEOUT_MS) == 0);
+    assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+    assert(line[OSP3_LOG_PROTOCOL_SIZE - 1] == '\n');
+    assert(osp3_log_parse((const char*) line, sizeof(line), &entry) == 0);
+    assert(osp3_log_checksum_test((const char*) line, sizeof(line), entry.checksum8_2s_compl,
+                                  entry.checksum8_xor) == 0);
+    assert(entry.ms == cfg.ms_start + i * ms_step);
+  }
+  assert(osp3sim_join(sim) == 0);
+  assert(osp3sim_lines_written(sim) == count);
+  assert(osp3_close(dev) == 0);
+  assert(osp3sim_close(sim) == 0);
+}
+
+// Leaves non-NUL bytes on the stack, where callees' line buffers will be.
+static void __attribute__((noinline)) fill_stack(void) {
+  volatile unsigned char junk[16 * 1024];
+  for (size_t i = 0; i < sizeof(junk); i++) {
+    junk[i] = '7';
+  }
+}
+
+static void test_osp3_open_path_probe(unsigned int interval_ms, unsigned int baud) {
+  osp3sim_config cfg;
+  osp3sim* sim;
+  osp3_device* dev;
+  osp3_probe_info info;
+  osp3_log_entry entry;
+  unsigned char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+  size_t transferred;
+  osp3_stats stats;
+  osp3sim_config_init(&cfg);
+  cfg.interval_ms = interval_ms;
+  cfg.baud = baud;
+  cfg.baud_check = 1;
+  assert((sim = osp3sim_open(&cfg)) != NULL);
+  // Not logging yet.
+  errno = 0;
+  assert(osp3_open_path_probe(osp3sim_path(sim), 100, &info) == NULL);
+  assert(errno == ETIME);
+  assert(osp3sim_start(sim) == 0);
+  // Lines must be parsed without reading past the bytes received.
+  fill_stack();
+  assert((dev = osp3_open_path_probe(osp3sim_path(sim), 0, &info)) != NULL);
+  assert(info.baud == baud);
+  assert(info.interval_ms == interval_ms);
+  assert(info.timeout_ms > 2 * interval_ms && info.timeout_ms < OSP3_PROBE_TIMEOUT_MS_DEFAULT);
+  // Counters start after probing.
+  assert(osp3_get_stats(dev, &stats) == 0);
+  assert(stats.lines == 0);
+  // The derived timeout is sufficient, though the next line may be incomplete.
+  assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, info.timeout_ms) == 0);
+  for (int i = 0; i < 10; i++) {
+    assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, info.timeout_ms) == 0);
+    line[transferred] = '\0';
+    assert(osp3_log_verify(dev, (const char*) line, transferred, &entry) == 0);
+  }
+  assert(osp3_close(dev) == 0);
+  assert(osp3sim_close(sim) == 0);
+}
+
+// Voluntary context switches (i.e., wakeups after blocking) by the calling thread, if available.
+static long nvcsw_thread(void) {
+#ifdef RUSAGE_THREAD
+  struct rusage ru;
+  assert(getrusage(RUSAGE_THREAD, &ru) == 0);
+  return ru.ru_nvcsw;
+#else
+  return 0;
+#endif
+}
+
+static double read_lines_schedule(osp3_schedule schedule) {
+  osp3sim_config cfg;
+  osp3sim* sim;
+  osp3_device* dev;
+  osp3_log_entry entry;
+  unsigned char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+  size_t transferred;
+  const unsigned long count = 200;
+  const unsigned long measured = 100;
+  long nvcsw = 0;
+  // Packets are spread out by baud rate pacing, so each wakes a blocking reader.
+  osp3sim_config_init(&cfg);
+  cfg.interval_ms = OSP3_INTERVAL_MS_DEFAULT;
+  cfg.baud = OSP3_BAUD_DEFAULT;
+  cfg.count = count;
+  assert((sim = osp3sim_open(&cfg)) != NULL);
+  assert((dev = osp3_open_path(osp3sim_path(sim), cfg.baud)) != NULL);
+  assert(osp3_set_schedule(dev, schedule) == 0);
+  assert(osp3sim_start(sim) == 0);
+  for (unsigned long i = 0; i < count; i++) {
+    if (i == count - measured) {
+      // After learning.
+      nvcsw = nvcsw_thread();
+    }
+    assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, READ_TIMEOUT_MS) == 0);
+    assert(osp3_log_verify(dev, (const char*) line, transferred, &entry) == 0);
+    assert(entry.ms == i * cfg.interval_ms);
+  }
+  const double per_line = (double) (nvcsw_thread() - nvcsw) / (double) measured;
+  assert(osp3sim_join(sim) == 0);
+  assert(osp3_close(dev) == 0);
+  assert(osp3sim_close(sim) == 0);
+  return per_line;
+}
+
+static void test_osp3_set_schedule_predict(void) {
+  errno = 0;
+  assert(osp3_set_schedule(NULL, OSP3_SCHEDULE_PREDICT) == -1);
+  assert(errno == EINVAL);
+  const double block = read_lines_schedule(OSP3_SCHEDULE_BLOCK);
+  const double predict = read_lines_schedule(OSP3_SCHEDULE_PREDICT);
+  printf("Wakeups per line: block=%.2f predict=%.2f\n", block, predict);
+  assert(predict <= block);
+}
+
+static void test_osp3_set_coalesce_sim(void) {
+  osp3sim_config cfg;
+  osp3sim* sim;
+  osp3_device* dev;
+  osp3_stats stats;
+  osp3_log_entry entry;
+  unsigned char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+  size_t transferred;
+  const unsigned int max_latency_ms = 100;
+  const unsigned long count = 50;
+  osp3sim_config_init(&cfg);
+  cfg.interval_ms = OSP3_INTERVAL_MS_DEFAULT;
+  cfg.baud = OSP3_BAUD_DEFAULT;
+  cfg.count = count;
+  assert((sim = osp3sim_open(&cfg)) != NULL);
+  assert((dev = osp3_open_path(osp3sim_path(sim), cfg.baud)) != NULL);
+  assert(osp3_set_coalesce(dev, max_latency_ms) == 0);
+  assert(osp3sim_start(sim) == 0);
+  const long nvcsw = nvcsw_thread();
+  for (unsigned long i = 0; i < count; i++) {
+    assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, READ_TIMEOUT_MS) == 0);
+    assert(osp3_log_verify(dev, (const char*) line, transferred, &entry) == 0);
+    assert(entry.ms == i * cfg.interval_ms);
+  }
+  const double per_line = (double) (nvcsw_thread() - nvcsw) / (double) count;
+  assert(osp3_get_stats(dev, &stats) == 0);
+  printf("Coalesced: reads per line=%.2f wakeups per line=%.2f\n", (double) stats.reads / (double) count, per_line);
+  // About a batch per `max_latency_ms`, but a line may straddle batches.
+  assert(stats.reads < count / 2);
+  assert(osp3sim_join(sim) == 0);
+  assert(osp3_close(dev) == 0);
+  assert(osp3sim_close(sim) == 0);
+}
+
+static void test_osp3_open_ex_sim(void) {
+  osp3_open_opts opts = OSP3_OPEN_OPTS_INIT;
+  osp3sim_config cfg;
+  osp3sim* sim;
+  osp3_device* dev;
+  osp3_log_entry entry;
+  unsigned char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+  size_t transferred;
+  uint64_t line_ns;
+  uint64_t written_ns;
+  const unsigned long count = 20;
+  osp3sim_config_init(&cfg);
+  cfg.interval_ms = OSP3_INTERVAL_MS_DEFAULT;
+  cfg.baud = OSP3_BAUD_DEFAULT;
+  cfg.count = count;
+  assert((sim = osp3sim_open(&cfg)) != NULL);
+  opts.baud = cfg.baud;
+  opts.clock = OSP3_CLOCK_MONOTONIC;
+  opts.schedule = OSP3_SCHEDULE_PREDICT;
+  assert((dev = osp3_open_ex(osp3sim_path(sim), &opts)) != NULL);
+  errno = 0;
+  assert(osp3_get_line_time(dev, &line_ns) == -1);
+  assert(errno == ENODATA);
+  assert(osp3sim_start(sim) == 0);
+  for (unsigned long i = 0; i < count; i++) {
+    assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, READ_TIMEOUT_MS) == 0);
+    assert(osp3_log_verify(dev, (const char*) line, transferred, &entry) == 0);
+    assert(entry.ms == i * cfg.interval_ms);
+    // The simulator records when a line was written after its write returns, which may be after the line was received.
+    assert(osp3_get_line_time(dev, &line_ns) == 0);
+    while (osp3sim_lines_written(sim) <= i) {
+      usleep(100);
+    }
+    assert(osp3sim_line_time(sim, entry.ms, &written_ns) == 0);
+    assert(line_ns + cfg.interval_ms * 1000000ull > written_ns);
+    assert(written_ns + cfg.interval_ms * 1000000ull > line_ns);
+  }
+  assert(osp3sim_join(sim) == 0);
+  assert(osp3_close(dev) == 0);
+  assert(osp3sim_close(sim) == 0);
+}
+
+static void test_osp3_open_ex_partial(void) {
+  const osp3_open_opts opts_skip = {
+    .size = sizeof(osp3_open_opts),
+    .flags = OSP3_OPEN_SKIP_PARTIAL,
+  };
+  const osp3_open_opts opts_keep = {
+    .size = sizeof(osp3_open_opts),
+    .flags = OSP3_OPEN_NO_FLUSH,
+  };
+  osp3_log_entry entry = { .ms = 10 };
+  char data[OSP3_LOG_PROTOCOL_SIZE + 1];
+  unsigned char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+  osp3_stats stats;
+  osp3_device* dev;
+  osp3_device* dev_keep;
+  size_t transferred;
+  const char* name;
+  const size_t half = OSP3_LOG_PROTOCOL_SIZE / 2;
+  int master;
+  assert(osp3_log_format(&entry, data) == 0);
+  assert((master = posix_openpt(O_RDWR | O_NOCTTY)) >= 0);
+  assert(grantpt(master) == 0 && unlockpt(master) == 0 && (name = ptsname(master)) != NULL);
+  assert((dev = osp3_open_ex(name, &opts_skip)) != NULL);
+  // The tail of a line that started before opening, then a complete line.
+  assert(write(master, &data[half], OSP3_LOG_PROTOCOL_SIZE - half) == (ssize_t) (OSP3_LOG_PROTOCOL_SIZE - half));
+  assert(write(master, data, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, READ_TIMEOUT_MS) == 0);
+  assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+  assert(osp3_get_stats(dev, &stats) == 0);
+  assert(stats.bytes_discarded == OSP3_LOG_PROTOCOL_SIZE - half);
+  assert(stats.lines == 1);
+  // Data received before opening is kept without flushing, including by another reader.
+  assert(write(master, data, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  assert((dev_keep = osp3_open_ex(name, &opts_keep)) != NULL);
+  assert(osp3_read_line(dev_keep, line, sizeof(line) - 1, &transferred, READ_TIMEOUT_MS) == 0);
+  assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+  assert(osp3_close(dev_keep) == 0);
+  // Flushing cuts lines short too, so skipping resumes.
+  assert(osp3_flush(dev) == 0);
+  assert(write(master, &data[half], OSP3_LOG_PROTOCOL_SIZE - half) == (ssize_t) (OSP3_LOG_PROTOCOL_SIZE - half));
+  assert(write(master, data, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  assert(osp3_read_line(dev, line, sizeof(line) - 1, &transferred, READ_TIMEOUT_MS) == 0);
+  assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+  assert(osp3_log_verify(dev, (const char*) line, transferred, &entry) == 0);
+  assert(osp3_close(dev) == 0);
+  assert(close(master) == 0);
+}
+
+static void test_osp3sim_faults_apply(void) {
+  osp3sim_faults faults;
+  char out[OSP3SIM_FAULTS_OUT_MAX];
+  size_t out_len;
+  uint32_t rng = 1;
+  const char* line = "0000815169,15296,0036,00550,0,00000,0000,00000,0,00,00000,0000,00000,0,00,14,12\r\n";
+  // No faults.
+  memset(&faults, 0, sizeof(faults));
+  assert(osp3sim_faults_apply(&faults, &rng, line, OSP3_LOG_PROTOCOL_SIZE, out, &out_len) == 0);
+  assert(out_len == OSP3_LOG_PROTOCOL_SIZE);
+  assert(!memcmp(out, line, out_len));
+  // Every byte dropped.
+  faults.drop_ppm = 1000000;
+  assert(osp3sim_faults_apply(&faults, &rng, line, OSP3_LOG_PROTOCOL_SIZE, out, &out_len) == 1);
+  assert(out_len == 0);
+  // Every byte duplicated.
+  memset(&faults, 0, sizeof(faults));
+  faults.dup_ppm = 1000000;
+  assert(osp3sim_faults_apply(&faults, &rng, line, OSP3_LOG_PROTOCOL_SIZE, out, &out_len) == 1);
+  assert(out_len == 2 * OSP3_LOG_PROTOCOL_SIZE);
+  // Every byte flipped.
+  memset(&faults, 0, sizeof(faults));
+  faults.flip_ppm = 1000000;
+  assert(osp3sim_faults_apply(&faults, &rng, line, OSP3_LOG_PROTOCOL_SIZE, out, &out_len) == 1);
+  assert(out_len == OSP3_LOG_PROTOCOL_SIZE);
+  for (size_t i = 0; i < out_len; i++) {
+    assert(out[i] != line[i]);
+  }
+  // Always truncated.
+  memset(&faults, 0, sizeof(faults));
+  faults.truncate_ppm = 1000000;
+  assert(osp3sim_faults_apply(&faults, &rng, line, OSP3_LOG_PROTOCOL_SIZE, out, &out_len) == 1);
+  assert(out_len < OSP3_LOG_PROTOCOL_SIZE);
+  // Always a (maximum length) noise burst.
+  memset(&faults, 0, sizeof(faults));
+  faults.burst_ppm = 1000000;
+  faults.burst_len = OSP3SIM_BURST_LEN_MAX + 1;
+  assert(osp3sim_faults_apply(&faults, &rng, line, OSP3_LOG_PROTOCOL_SIZE, out, &out_len) == 1);
+  assert(out_len == OSP3_LOG_PROTOCOL_SIZE + OSP3SIM_BURST_LEN_MAX);
+}
+
+static void test_osp3_read_line_sim_faults(int resync) {
+  osp3sim_config cfg;
+  osp3sim* sim;
+  osp3_device* dev;
+  osp3_log_entry entry;
+  osp3sim_recovery rec;
+  // Smaller than noise bursts, so some reads overflow the buffer.
+  unsigned char line[2 * OSP3_LOG_PROTOCOL_SIZE];
+  size_t transferred;
+  size_t discarded;
+  size_t discarded_total = 0;
+  osp3sim_config_init(&cfg);
+  cfg.interval_ms = 0;
+  cfg.count = 5000;
+  cfg.faults.drop_ppm = 200;
+  cfg.faults.flip_ppm = 200;
+  cfg.faults.dup_ppm = 200;
+  cfg.faults.truncate_ppm = 5000;
+  cfg.faults.burst_ppm = 5000;
+  cfg.faults.burst_len = 256;
+  cfg.faults.split_ppm = 100000;
+  cfg.faults.delay_ppm = 1000;
+  cfg.faults.delay_ms = 20;
+  osp3sim_recovery_init(&rec);
+  assert((sim = osp3sim_open(&cfg)) != NULL);
+  assert((dev = osp3_open_path(osp3sim_path(sim), 0)) != NULL);
+  assert(osp3sim_start(sim) == 0);
+  while (1) {
+    memset(line, 0, sizeof(line));
+    discarded = 0;
+    const int ret = resync ?
+      osp3_read_line_resync(dev, line, sizeof(line) - 1, &transferred, &discarded, READ_TIMEOUT_MS) :
+      osp3_read_line(dev, line, sizeof(line) - 1, &transferred, READ_TIMEOUT_MS);
+    discarded_total += discarded;
+    if (ret < 0) {
+      if (errno == ETIME) {
+        break;
+      }
+      // Oversize lines are only reported without resync.
+      assert(!resync);
+      assert(errno == ENOBUFS);
+      osp3sim_recovery_record(&rec, 0, osp3sim_now_ns());
+      continue;
+    }
+    const int good = transferred == OSP3_LOG_PROTOCOL_SIZE &&
+                     osp3_log_parse((const char*) line, sizeof(line), &entry) == 0 &&
+                     osp3_log_checksum_test((const char*) line, sizeof(line), entry.checksum8_2s_compl,
+                                            entry.checksum8_xor) == 0;
+    osp3sim_recovery_record(&rec, good, osp3sim_now_ns());
+  }
+  assert(osp3sim_join(sim) == 0);
+  assert(osp3sim_lines_written(sim) == cfg.count);
+  osp3sim_recovery_finish(&rec, sim);
+  printf("Recovery (%s): intact=%lu faulted=%lu good=%lu bad=%lu rate=%.4f resyncs=%lu run_max=%lu "
+         "resync_us_max=%.1f\n",
+         resync ? "resync" : "no resync", rec.lines_intact, rec.lines_faulted, rec.samples_good, rec.samples_bad, osp3sim_recovery_rate(&rec),
+         rec.resyncs, rec.resync_run_max, (double) rec.resync_ns_max / 1000.0);
+  assert(rec.lines_faulted > 0);
+  assert(osp3sim_recovery_rate(&rec) >= RECOVERY_RATE_MIN);
+  // Noise bursts always produce oversize lines.
+  assert(resync ? discarded_total > 0 : discarded_total == 0);
+  assert(osp3_close(dev) == 0);
+  assert(osp3sim_close(sim) == 0);
+}
+
+int main(void) {
+  test_osp3sim_gen();
+  test_osp3_open_path_bad_baud();
+  test_osp3_open_path_not_tty();
+  // Unpaced, device packet size.
+  test_osp3_read_line_sim(0, 0, OSP3_W_MAX_PACKET_SIZE);
+  // Fastest interval at the highest baud rate.
+  test_osp3_read_line_sim(OSP3_INTERVAL_MS_MIN, OSP3_BAUD_MAX, OSP3_W_MAX_PACKET_SIZE);
+  // Default interval and baud rate, with small and odd packet sizes.
+  test_osp3_read_line_sim(OSP3_INTERVAL_MS_DEFAULT, OSP3_BAUD_DEFAULT, 7);
+  test_osp3_read_line_sim(OSP3_INTERVAL_MS_DEFAULT, OSP3_BAUD_DEFAULT, 1);
+  // The default baud rate, and one that's probed late.
+  test_osp3_open_path_probe(OSP3_INTERVAL_MS_DEFAULT, OSP3_BAUD_DEFAULT);
+  test_osp3_open_path_probe(OSP3_INTERVAL_MS_MIN, 57600);
+  test_osp3_set_schedule_predict();
+  test_osp3_set_coalesce_sim();
+  test_osp3_open_ex_sim();
+  test_osp3_open_ex_partial();
+  test_osp3sim_faults_apply();
+  test_osp3_read_line_sim_faults(0);
+  test_osp3_read_line_sim_faults(1);
+  return 0;
+}
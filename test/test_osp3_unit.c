@@ -1,7 +1,12 @@
 #undef NDEBUG
 #include <assert.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <osp3.h>
 
 // From the wiki.
@@ -29,7 +34,13 @@ static void test_osp3_open_path_bad(void) {
   errno = 0;
   assert(osp3_open_path(NULL, 0) == NULL);
   assert(errno == EINVAL);
-  // TODO: To test bad baud values without trying to open a device, osp3_open_path would have to be refactored.
+  // Bad baud values are tested against a simulated device in test_osp3_sim.
+}
+
+static void test_osp3_open_mem_bad(void) {
+  errno = 0;
+  assert(osp3_open_mem(NULL, 1, 0) == NULL);
+  assert(errno == EINVAL);
 }
 
 static void test_osp3_close_bad(void) {
@@ -38,6 +49,20 @@ static void test_osp3_close_bad(void) {
   assert(errno == EINVAL);
 }
 
+static void test_osp3_get_fd_bad(void) {
+  const char data[] = "\n";
+  osp3_device* dev;
+  errno = 0;
+  assert(osp3_get_fd(NULL) == -1);
+  assert(errno == EINVAL);
+  // In-memory devices have no file descriptor.
+  assert((dev = osp3_open_mem(data, sizeof(data) - 1, 0)) != NULL);
+  errno = 0;
+  assert(osp3_get_fd(dev) == -1);
+  assert(errno == ENOTSUP);
+  assert(osp3_close(dev) == 0);
+}
+
 static void test_osp3_flush_bad(void) {
   errno = 0;
   assert(osp3_flush(NULL) == -1);
@@ -76,6 +101,705 @@ static void test_osp3_read_line_bad(void) {
   assert(errno == EINVAL);
 }
 
+static void test_osp3_read_line_resync_bad(void) {
+  int dummy = 0;
+  size_t transferred;
+  size_t discarded;
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE];
+  // NULL arguments.
+  errno = 0;
+  assert(osp3_read_line_resync(NULL, buf, sizeof(buf), &transferred, &discarded, 0) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_read_line_resync((osp3_device*) &dummy, NULL, sizeof(buf), &transferred, &discarded, 0) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_read_line_resync((osp3_device*) &dummy, buf, sizeof(buf), NULL, &discarded, 0) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_read_line_resync((osp3_device*) &dummy, buf, sizeof(buf), &transferred, NULL, 0) == -1);
+  assert(errno == EINVAL);
+  // Zero-length buffer.
+  errno = 0;
+  assert(osp3_read_line_resync((osp3_device*) &dummy, buf, 0, &transferred, &discarded, 0) == -1);
+  assert(errno == EINVAL);
+}
+
+static void test_osp3_read_mem(size_t packet_size) {
+  osp3_device* dev;
+  unsigned char buf[OSP3_W_MAX_PACKET_SIZE];
+  size_t transferred;
+  size_t total = 0;
+  assert((dev = osp3_open_mem(test_log1, sizeof(test_log1) - 1, packet_size)) != NULL);
+  do {
+    assert(osp3_read(dev, buf, sizeof(buf), &transferred, 0) == 0);
+    assert(transferred <= packet_size);
+    assert(!memcmp(buf, &test_log1[total], transferred));
+    total += transferred;
+  } while (transferred > 0);
+  assert(total == sizeof(test_log1) - 1);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_read_line_mem(size_t packet_size) {
+  static const char* const lines[] = { test_log1, test_log2, test_log3, test_log4 };
+  char data[4 * OSP3_LOG_PROTOCOL_SIZE + sizeof(test_log_no_newline) - 1];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE + 1];
+  osp3_device* dev;
+  size_t transferred;
+  for (size_t i = 0; i < 4; i++) {
+    memcpy(&data[i * OSP3_LOG_PROTOCOL_SIZE], lines[i], OSP3_LOG_PROTOCOL_SIZE);
+  }
+  // Ends with a partial line.
+  memcpy(&data[4 * OSP3_LOG_PROTOCOL_SIZE], test_log_no_newline, sizeof(test_log_no_newline) - 1);
+  assert((dev = osp3_open_mem(data, sizeof(data), packet_size)) != NULL);
+  for (size_t i = 0; i < 4; i++) {
+    memset(buf, 0, sizeof(buf));
+    assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == 0);
+    assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+    assert(!memcmp(buf, lines[i], OSP3_LOG_PROTOCOL_SIZE));
+  }
+  errno = 0;
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == -1);
+  assert(errno == ENODATA);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_read_line_resync_mem(void) {
+  // An oversize line (a line missing its newline runs into the next), then a valid line.
+  const size_t oversize_len = sizeof(test_log_no_newline) - 1 + OSP3_LOG_PROTOCOL_SIZE;
+  char data[sizeof(test_log_no_newline) - 1 + 2 * OSP3_LOG_PROTOCOL_SIZE];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE];
+  osp3_device* dev;
+  size_t transferred;
+  size_t discarded;
+  memcpy(data, test_log_no_newline, sizeof(test_log_no_newline) - 1);
+  memcpy(&data[sizeof(test_log_no_newline) - 1], test_log1, OSP3_LOG_PROTOCOL_SIZE);
+  memcpy(&data[oversize_len], test_log2, OSP3_LOG_PROTOCOL_SIZE);
+  assert((dev = osp3_open_mem(data, sizeof(data), 0)) != NULL);
+  assert(osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, 0) == 0);
+  assert(discarded == oversize_len);
+  assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+  assert(!memcmp(buf, test_log2, OSP3_LOG_PROTOCOL_SIZE));
+  errno = 0;
+  assert(osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, 0) == -1);
+  assert(errno == ENODATA);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_read_line_resync_fd(void) {
+  // Several buffers' worth of a line without a newline.
+  unsigned char buf[16];
+  osp3_stats stats;
+  osp3_device* dev;
+  size_t transferred;
+  size_t discarded;
+  int fds[2];
+  assert(pipe(fds) == 0);
+  assert((dev = osp3_open_fd(fds[0])) != NULL);
+  assert(write(fds[1], test_log_no_newline, 50) == 50);
+  // Times out partway through discarding the oversize line.
+  errno = 0;
+  assert(osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, 1) == -1);
+  assert(errno == ETIME);
+  // The rest of the oversize line, then a line that fits.
+  assert(write(fds[1], "0123456789\n", 11) == 11);
+  assert(write(fds[1], "abc\n", 4) == 4);
+  assert(osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, 1000) == 0);
+  assert(transferred == 4);
+  assert(!memcmp(buf, "abc\n", 4));
+  assert(discarded == 11);
+  assert(osp3_get_stats(dev, &stats) == 0);
+  assert(stats.lines_oversize == 1);
+  assert(stats.resyncs == 1);
+  assert(stats.bytes_discarded == 61);
+  assert(osp3_close(dev) == 0);
+  assert(close(fds[0]) == 0);
+  assert(close(fds[1]) == 0);
+}
+
+static void test_osp3_set_coalesce_bad(void) {
+  errno = 0;
+  assert(osp3_set_coalesce(NULL, 1) == -1);
+  assert(errno == EINVAL);
+}
+
+static void test_osp3_set_coalesce_mem(void) {
+  static const char* const lines[] = { test_log1, test_log2, test_log3, test_log4 };
+  char data[4 * OSP3_LOG_PROTOCOL_SIZE];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE + 1];
+  osp3_stats stats;
+  osp3_device* dev;
+  size_t transferred;
+  for (size_t i = 0; i < 4; i++) {
+    memcpy(&data[i * OSP3_LOG_PROTOCOL_SIZE], lines[i], OSP3_LOG_PROTOCOL_SIZE);
+  }
+  // Deliver everything at once, as a kernel buffer would after a batch's sleep.
+  assert((dev = osp3_open_mem(data, sizeof(data), sizeof(data))) != NULL);
+  errno = 0;
+  assert(osp3_set_coalesce(dev, OSP3_COALESCE_MS_MAX + 1) == -1);
+  assert(errno == EINVAL);
+  assert(osp3_set_coalesce(dev, 1) == 0);
+  for (size_t i = 0; i < 4; i++) {
+    assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == 0);
+    assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+    assert(!memcmp(buf, lines[i], OSP3_LOG_PROTOCOL_SIZE));
+    if (i == 0) {
+      // Can't stop with data buffered.
+      errno = 0;
+      assert(osp3_set_coalesce(dev, 0) == -1);
+      assert(errno == EBUSY);
+    }
+  }
+  // Every line came from a single read.
+  assert(osp3_get_stats(dev, &stats) == 0);
+  assert(stats.reads == 1);
+  assert(stats.lines == 4);
+  errno = 0;
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == -1);
+  assert(errno == ENODATA);
+  assert(osp3_set_coalesce(dev, 0) == 0);
+  assert(osp3_close(dev) == 0);
+}
+
+static uint64_t test_now_ms(void) {
+  struct timespec ts;
+  assert(clock_gettime(CLOCK_MONOTONIC, &ts) == 0);
+  return (uint64_t) ts.tv_sec * 1000 + (uint64_t) ts.tv_nsec / 1000000;
+}
+
+static void test_osp3_set_coalesce_timeout(void) {
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE + 1];
+  osp3_device* dev;
+  size_t transferred;
+  uint64_t start;
+  int fds[2];
+  assert(pipe(fds) == 0);
+  assert((dev = osp3_open_fd(fds[0])) != NULL);
+  assert(osp3_set_coalesce(dev, OSP3_COALESCE_MS_MAX) == 0);
+  // The first batch is read immediately.
+  errno = 0;
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 100) == -1);
+  assert(errno == ETIME);
+  // Sleeping for the next batch uses up the timeout, so there's no wait for data after it.
+  for (int i = 0; i < 2; i++) {
+    start = test_now_ms();
+    errno = 0;
+    if (i == 0) {
+      assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 100) == -1);
+    } else {
+      assert(osp3_wait(dev, 100) == -1);
+    }
+    assert(errno == ETIME);
+    assert(test_now_ms() - start < 190);
+  }
+  assert(osp3_close(dev) == 0);
+  assert(close(fds[0]) == 0);
+  assert(close(fds[1]) == 0);
+}
+
+static void test_osp3_open_fd_bad(void) {
+  errno = 0;
+  assert(osp3_open_fd(-1) == NULL);
+  assert(errno == EINVAL);
+}
+
+static void test_osp3_wait_bad(void) {
+  errno = 0;
+  assert(osp3_wait(NULL, 0) == -1);
+  assert(errno == EINVAL);
+}
+
+static void test_osp3_read_line_fd(void) {
+  static const char* const lines[] = { test_log1, test_log2, test_log3, test_log4 };
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE];
+  osp3_device* dev;
+  size_t transferred;
+  int fds[2];
+  // Writes fit in the pipe buffer, so there's no need for a separate writer thread.
+  assert(pipe(fds) == 0);
+  assert((dev = osp3_open_fd(fds[0])) != NULL);
+  assert(osp3_get_fd(dev) == fds[0]);
+  // Nothing written yet.
+  errno = 0;
+  assert(osp3_wait(dev, 1) == -1);
+  assert(errno == ETIME);
+  errno = 0;
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 1) == -1);
+  assert(errno == ETIME);
+  for (size_t i = 0; i < 4; i++) {
+    assert(write(fds[1], lines[i], OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  }
+  assert(close(fds[1]) == 0);
+  for (size_t i = 0; i < 4; i++) {
+    assert(osp3_wait(dev, 1000) == 0);
+    assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 1000) == 0);
+    assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+    assert(!memcmp(buf, lines[i], OSP3_LOG_PROTOCOL_SIZE));
+  }
+  errno = 0;
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 1000) == -1);
+  assert(errno == ENODATA);
+  // The end of the data doesn't block.
+  assert(osp3_wait(dev, 1000) == 0);
+  assert(osp3_close(dev) == 0);
+  // The file descriptor is left open.
+  assert(close(fds[0]) == 0);
+}
+
+// Room for a device with small reserved buffers.
+static _Alignas(OSP3_DEVICE_ALIGN) unsigned char test_storage[64 * 1024];
+
+static void test_osp3_open_into_bad(void) {
+  const osp3_buffer_opts opts = { .fd_buf_size = 256, .coalesce_buf_size = 0 };
+  static const char data[] = "\n";
+  assert(osp3_device_size(NULL) % OSP3_DEVICE_ALIGN == 0);
+  assert(osp3_device_size(&opts) >= osp3_device_size(NULL) + opts.fd_buf_size);
+  assert(osp3_device_size(&opts) <= sizeof(test_storage));
+  errno = 0;
+  assert(osp3_open_mem_into(NULL, sizeof(test_storage), NULL, data, 1, 0) == NULL);
+  assert(errno == EINVAL);
+  // Misaligned.
+  errno = 0;
+  assert(osp3_open_mem_into(&test_storage[8], sizeof(test_storage) - 8, NULL, data, 1, 0) == NULL);
+  assert(errno == EINVAL);
+  // Too small.
+  errno = 0;
+  assert(osp3_open_mem_into(test_storage, osp3_device_size(NULL) - 1, NULL, data, 1, 0) == NULL);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_open_fd_into(test_storage, osp3_device_size(&opts) - 1, &opts, 0) == NULL);
+  assert(errno == EINVAL);
+  // A file descriptor device requires a buffer.
+  errno = 0;
+  assert(osp3_open_fd_into(test_storage, sizeof(test_storage), NULL, 0) == NULL);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_open_fd_into(test_storage, sizeof(test_storage), &opts, -1) == NULL);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_open_path_into(test_storage, sizeof(test_storage), NULL, NULL, 0) == NULL);
+  assert(errno == EINVAL);
+}
+
+static void test_osp3_read_line_mem_into(void) {
+  static const char* const lines[] = { test_log1, test_log2, test_log3, test_log4 };
+  // Smaller than the data, so batches span multiple reads.
+  const osp3_buffer_opts opts = { .fd_buf_size = 0, .coalesce_buf_size = 2 * OSP3_LOG_PROTOCOL_SIZE };
+  char data[4 * OSP3_LOG_PROTOCOL_SIZE];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE + 1];
+  osp3_stats stats;
+  osp3_device* dev;
+  size_t transferred;
+  for (size_t i = 0; i < 4; i++) {
+    memcpy(&data[i * OSP3_LOG_PROTOCOL_SIZE], lines[i], OSP3_LOG_PROTOCOL_SIZE);
+  }
+  assert((dev = osp3_open_mem_into(test_storage, osp3_device_size(&opts), &opts, data, sizeof(data),
+                                   sizeof(data))) != NULL);
+  assert((void*) dev == test_storage);
+  assert(osp3_set_coalesce(dev, 1) == 0);
+  for (size_t i = 0; i < 4; i++) {
+    assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == 0);
+    assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+    assert(!memcmp(buf, lines[i], OSP3_LOG_PROTOCOL_SIZE));
+  }
+  assert(osp3_get_stats(dev, &stats) == 0);
+  assert(stats.reads == 2);
+  assert(osp3_set_coalesce(dev, 0) == 0);
+  // The reserved buffer is reused.
+  assert(osp3_set_coalesce(dev, 1) == 0);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_read_line_fd_into(void) {
+  const osp3_buffer_opts opts = { .fd_buf_size = OSP3_LOG_PROTOCOL_SIZE, .coalesce_buf_size = 0 };
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE];
+  osp3_device* dev;
+  size_t transferred;
+  int fds[2];
+  assert(pipe(fds) == 0);
+  assert((dev = osp3_open_fd_into(test_storage, sizeof(test_storage), &opts, fds[0])) != NULL);
+  assert(write(fds[1], test_log1, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  assert(write(fds[1], test_log2, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  assert(close(fds[1]) == 0);
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 1000) == 0);
+  assert(!memcmp(buf, test_log1, OSP3_LOG_PROTOCOL_SIZE));
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 1000) == 0);
+  assert(!memcmp(buf, test_log2, OSP3_LOG_PROTOCOL_SIZE));
+  errno = 0;
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 1000) == -1);
+  assert(errno == ENODATA);
+  assert(osp3_close(dev) == 0);
+  assert(close(fds[0]) == 0);
+}
+
+static void test_osp3_open_ex_bad(void) {
+  // As if compiled against a newer version with an extra option.
+  struct {
+    osp3_open_opts opts;
+    unsigned long extra;
+  } newer = { .opts = OSP3_OPEN_OPTS_INIT, .extra = 1 };
+  osp3_open_opts opts = OSP3_OPEN_OPTS_INIT;
+  errno = 0;
+  assert(osp3_open_ex(NULL, &opts) == NULL);
+  assert(errno == EINVAL);
+  opts.size = sizeof(opts.size);
+  errno = 0;
+  assert(osp3_open_ex("/", &opts) == NULL);
+  assert(errno == EINVAL);
+  opts.size = sizeof(opts);
+  opts.flags = 0x80000000;
+  errno = 0;
+  assert(osp3_open_ex("/", &opts) == NULL);
+  assert(errno == EINVAL);
+  opts.flags = 0;
+  opts.clock = (osp3_clock) -1;
+  errno = 0;
+  assert(osp3_open_ex("/", &opts) == NULL);
+  assert(errno == EINVAL);
+  opts.clock = OSP3_CLOCK_NONE;
+  opts.schedule = (osp3_schedule) -1;
+  errno = 0;
+  assert(osp3_open_ex("/", &opts) == NULL);
+  assert(errno == EINVAL);
+  opts.schedule = OSP3_SCHEDULE_BLOCK;
+  opts.coalesce_ms = OSP3_COALESCE_MS_MAX + 1;
+  errno = 0;
+  assert(osp3_open_ex("/", &opts) == NULL);
+  assert(errno == EINVAL);
+  opts.coalesce_ms = 0;
+  opts.storage = &test_storage[8];
+  opts.storage_size = sizeof(test_storage) - 8;
+  errno = 0;
+  assert(osp3_open_ex("/", &opts) == NULL);
+  assert(errno == EINVAL);
+  newer.opts.size = sizeof(newer);
+  errno = 0;
+  assert(osp3_open_ex("/", &newer.opts) == NULL);
+  assert(errno == ENOTSUP);
+  // Unset newer options are fine, so this gets as far as opening the path.
+  newer.extra = 0;
+  errno = 0;
+  assert(osp3_open_ex("/", &newer.opts) == NULL);
+  assert(errno == ENOTTY);
+  errno = 0;
+  assert(osp3_open_ex("/", NULL) == NULL);
+  assert(errno == ENOTTY);
+}
+
+static void test_osp3_get_line_time_mem(void) {
+  const size_t len = 2 * OSP3_LOG_PROTOCOL_SIZE;
+  char data[2 * OSP3_LOG_PROTOCOL_SIZE];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE + 1];
+  osp3_device* dev;
+  size_t transferred;
+  uint64_t ns;
+  uint64_t ns_prev;
+  memcpy(data, test_log1, OSP3_LOG_PROTOCOL_SIZE);
+  memcpy(&data[OSP3_LOG_PROTOCOL_SIZE], test_log2, OSP3_LOG_PROTOCOL_SIZE);
+  assert((dev = osp3_open_mem(data, len, len)) != NULL);
+  errno = 0;
+  assert(osp3_set_clock(NULL, OSP3_CLOCK_MONOTONIC) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_set_clock(dev, (osp3_clock) (OSP3_CLOCK_BOOTTIME + 1)) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_get_line_time(NULL, &ns) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_get_line_time(dev, NULL) == -1);
+  assert(errno == EINVAL);
+  // No clock set.
+  errno = 0;
+  assert(osp3_get_line_time(dev, &ns) == -1);
+  assert(errno == EINVAL);
+  assert(osp3_set_clock(dev, OSP3_CLOCK_REALTIME) == 0);
+  // Both lines are read in one batch.
+  assert(osp3_set_coalesce(dev, 1) == 0);
+  errno = 0;
+  assert(osp3_get_line_time(dev, &ns) == -1);
+  assert(errno == ENODATA);
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == 0);
+  assert(osp3_get_line_time(dev, &ns_prev) == 0);
+  assert(ns_prev > 0);
+  // The second line was received with the first.
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == 0);
+  assert(osp3_get_line_time(dev, &ns) == 0);
+  assert(ns == ns_prev);
+  assert(osp3_set_clock(dev, OSP3_CLOCK_NONE) == 0);
+  errno = 0;
+  assert(osp3_get_line_time(dev, &ns) == -1);
+  assert(errno == EINVAL);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_open_follow_bad(void) {
+  errno = 0;
+  assert(osp3_open_follow(NULL, 0) == NULL);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_open_follow("/nonexistent/osp3.log", 0) == NULL);
+#ifdef __linux__
+  assert(errno == ENOENT);
+#else
+  assert(errno == ENOTSUP);
+#endif
+}
+
+#ifdef __linux__
+static void read_line_follow(osp3_device* dev, const char* line) {
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE];
+  size_t transferred;
+  assert(osp3_wait(dev, 1000) == 0);
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 1000) == 0);
+  assert(transferred == OSP3_LOG_PROTOCOL_SIZE);
+  assert(!memcmp(buf, line, OSP3_LOG_PROTOCOL_SIZE));
+}
+
+static void test_osp3_read_line_follow(void) {
+  char path[] = "/tmp/test_osp3_follow_XXXXXX";
+  char path_old[sizeof(path) + 2];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE];
+  osp3_device* dev;
+  size_t transferred;
+  int fd;
+  // Writes are complete before reads, so there's no need for a separate writer thread.
+  assert((fd = mkstemp(path)) >= 0);
+  snprintf(path_old, sizeof(path_old), "%s.1", path);
+  assert(write(fd, test_log1, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  assert((dev = osp3_open_follow(path, 0)) != NULL);
+  read_line_follow(dev, test_log1);
+  // Waits at the end of the file instead of failing with ENODATA.
+  errno = 0;
+  assert(osp3_wait(dev, 1) == -1);
+  assert(errno == ETIME);
+  errno = 0;
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 1) == -1);
+  assert(errno == ETIME);
+  // Appended.
+  assert(write(fd, test_log2, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  read_line_follow(dev, test_log2);
+  // Truncated.
+  assert(ftruncate(fd, 0) == 0);
+  assert(lseek(fd, 0, SEEK_SET) == 0);
+  assert(write(fd, test_log3, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  read_line_follow(dev, test_log3);
+  // Rotated - the old file is read to its end before switching to the new one.
+  assert(write(fd, test_log1, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  assert(rename(path, path_old) == 0);
+  assert(close(fd) == 0);
+  assert((fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600)) >= 0);
+  assert(write(fd, test_log4, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  read_line_follow(dev, test_log1);
+  read_line_follow(dev, test_log4);
+  assert(osp3_close(dev) == 0);
+  // Starting at the end only reads new data.
+  assert((dev = osp3_open_follow(path, 1)) != NULL);
+  assert(write(fd, test_log2, OSP3_LOG_PROTOCOL_SIZE) == OSP3_LOG_PROTOCOL_SIZE);
+  read_line_follow(dev, test_log2);
+  assert(osp3_close(dev) == 0);
+  assert(close(fd) == 0);
+  assert(unlink(path) == 0);
+  assert(unlink(path_old) == 0);
+}
+#endif
+
+static void test_osp3_get_stats_bad(void) {
+  int dummy = 0;
+  osp3_stats stats;
+  errno = 0;
+  assert(osp3_get_stats(NULL, &stats) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_get_stats((osp3_device*) &dummy, NULL) == -1);
+  assert(errno == EINVAL);
+}
+
+static void test_osp3_get_stats_mem(void) {
+  // An oversize line, two valid lines, and a partial line.
+  char data[sizeof(test_log_no_newline) - 1 + 3 * OSP3_LOG_PROTOCOL_SIZE + 10];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE];
+  osp3_stats stats;
+  osp3_device* dev;
+  size_t transferred;
+  size_t discarded;
+  memcpy(data, test_log_no_newline, sizeof(test_log_no_newline) - 1);
+  memcpy(&data[sizeof(test_log_no_newline) - 1], test_log1, OSP3_LOG_PROTOCOL_SIZE);
+  memcpy(&data[sizeof(test_log_no_newline) - 1 + OSP3_LOG_PROTOCOL_SIZE], test_log2, OSP3_LOG_PROTOCOL_SIZE);
+  memcpy(&data[sizeof(test_log_no_newline) - 1 + 2 * OSP3_LOG_PROTOCOL_SIZE], test_log3, OSP3_LOG_PROTOCOL_SIZE);
+  memcpy(&data[sizeof(test_log_no_newline) - 1 + 3 * OSP3_LOG_PROTOCOL_SIZE], test_log4, 10);
+  assert((dev = osp3_open_mem(data, sizeof(data), 0)) != NULL);
+  assert(osp3_get_stats(dev, &stats) == 0);
+  assert(stats.bytes_read == 0);
+  assert(stats.reads == 0);
+  assert(osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, 0) == 0);
+  assert(osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, 0) == 0);
+  assert(osp3_read_line_resync(dev, buf, sizeof(buf), &transferred, &discarded, 0) == -1);
+  assert(errno == ENODATA);
+  assert(osp3_get_stats(dev, &stats) == 0);
+  assert(stats.bytes_read == sizeof(data));
+  assert(stats.reads > 0);
+  assert(stats.timeouts == 0);
+  // The oversize line's tail is completed (and discarded) too.
+  assert(stats.lines == 3);
+  assert(stats.lines_partial == 1);
+  assert(stats.lines_oversize == 1);
+  assert(stats.resyncs == 1);
+  assert(stats.bytes_discarded == sizeof(test_log_no_newline) - 1 + OSP3_LOG_PROTOCOL_SIZE);
+  // No kernel error counters.
+  assert(stats.kernel_counters == 0);
+  assert(stats.overruns == 0);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_log_verify(void) {
+  char bad_format[sizeof(test_log1)];
+  char bad_checksum[sizeof(test_log1)];
+  char line[sizeof(test_log1)];
+  osp3_log_entry entry;
+  osp3_stats stats;
+  osp3_device* dev;
+  memcpy(bad_format, test_log1, sizeof(test_log1));
+  bad_format[3] = 'x';
+  memcpy(bad_checksum, test_log1, sizeof(test_log1));
+  bad_checksum[OSP3_LOG_PROTOCOL_SIZE - 3] = bad_checksum[OSP3_LOG_PROTOCOL_SIZE - 3] == '0' ? '1' : '0';
+  // NULL arguments.
+  errno = 0;
+  assert(osp3_log_verify(NULL, NULL, sizeof(test_log1), &entry) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_log_verify(NULL, test_log1, sizeof(test_log1), NULL) == -1);
+  assert(errno == EINVAL);
+  // No device.
+  assert(osp3_log_verify(NULL, test_log1, sizeof(test_log1), &entry) == 0);
+  assert(entry.ms == 815169);
+  assert(osp3_log_verify(NULL, bad_format, sizeof(bad_format), &entry) == 1);
+  assert(osp3_log_verify(NULL, bad_checksum, sizeof(bad_checksum), &entry) == 2);
+  // Record outcomes.
+  assert((dev = osp3_open_mem(NULL, 0, 0)) != NULL);
+  assert(osp3_log_verify(dev, test_log2, sizeof(test_log2), &entry) == 0);
+  assert(osp3_log_verify(dev, test_log3, sizeof(test_log3), &entry) == 0);
+  assert(osp3_log_verify(dev, bad_format, sizeof(bad_format), &entry) == 1);
+  assert(osp3_log_verify(dev, bad_checksum, sizeof(bad_checksum), &entry) == 2);
+  // Skipping test_log4 is a gap, and test_log1 is a reset.
+  memset(&entry, 0, sizeof(entry));
+  entry.ms = 343732217;
+  assert(osp3_log_format(&entry, line) == 0);
+  line[OSP3_LOG_PROTOCOL_SIZE] = '\0';
+  assert(osp3_log_verify(dev, line, sizeof(line), &entry) == 0);
+  assert(osp3_log_verify(dev, test_log1, sizeof(test_log1), &entry) == 0);
+  assert(osp3_get_stats(dev, &stats) == 0);
+  assert(stats.parse_failures == 1);
+  assert(stats.checksum_failures == 1);
+  assert(stats.ms_gaps == 1);
+  assert(stats.ms_resets == 1);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_latency_bad(void) {
+  osp3_latency_stats stats;
+  // Either invalid, or not compiled in.
+  errno = 0;
+  assert(osp3_latency_mark(NULL, OSP3_LATENCY_MARK_PARSED) == -1);
+  assert(errno == EINVAL || errno == ENOTSUP);
+  errno = 0;
+  assert(osp3_latency_get(NULL, OSP3_LATENCY_STAGE_TOTAL, &stats) == -1);
+  assert(errno == EINVAL || errno == ENOTSUP);
+  errno = 0;
+  assert(osp3_latency_reset(NULL) == -1);
+  assert(errno == EINVAL || errno == ENOTSUP);
+}
+
+static void test_osp3_latency_mem(void) {
+  static const char* const lines[] = { test_log1, test_log2, test_log3, test_log4 };
+  char data[4 * OSP3_LOG_PROTOCOL_SIZE];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE];
+  osp3_latency_stats stats;
+  osp3_device* dev;
+  size_t transferred;
+  for (size_t i = 0; i < 4; i++) {
+    memcpy(&data[i * OSP3_LOG_PROTOCOL_SIZE], lines[i], OSP3_LOG_PROTOCOL_SIZE);
+  }
+  assert((dev = osp3_open_mem(data, sizeof(data), 7)) != NULL);
+  errno = 0;
+  if (osp3_latency_get(dev, OSP3_LATENCY_STAGE_TOTAL, &stats) < 0) {
+    assert(errno == ENOTSUP);
+    assert(osp3_close(dev) == 0);
+    return;
+  }
+  assert(stats.count == 0);
+  for (size_t i = 0; i < 4; i++) {
+    assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == 0);
+    assert(osp3_latency_mark(dev, OSP3_LATENCY_MARK_PARSED) == 0);
+    assert(osp3_latency_mark(dev, OSP3_LATENCY_MARK_DELIVERED) == 0);
+    // Repeated events are ignored.
+    assert(osp3_latency_mark(dev, OSP3_LATENCY_MARK_DELIVERED) == 0);
+  }
+  for (int stage = 0; stage < OSP3_LATENCY_STAGE_COUNT; stage++) {
+    assert(osp3_latency_get(dev, (osp3_latency_stage) stage, &stats) == 0);
+    assert(stats.count == 4);
+    assert(stats.p50_ns <= stats.p99_ns);
+    assert(stats.p99_ns <= stats.max_ns);
+  }
+  assert(osp3_latency_reset(dev) == 0);
+  assert(osp3_latency_get(dev, OSP3_LATENCY_STAGE_TOTAL, &stats) == 0);
+  assert(stats.count == 0);
+  assert(stats.max_ns == 0);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_self_stats_bad(void) {
+  osp3_self_stats self;
+  osp3_device* dev;
+  errno = 0;
+  assert(osp3_self_stats_reset(NULL, OSP3_SELF_PROCESS) == -1);
+  assert(errno == EINVAL);
+  assert((dev = osp3_open_mem(test_log1, sizeof(test_log1) - 1, 0)) != NULL);
+  errno = 0;
+  assert(osp3_self_stats_reset(dev, (osp3_self_scope) -1) == -1);
+  assert(errno == EINVAL);
+  // Not reset yet.
+  errno = 0;
+  assert(osp3_self_stats_get(dev, &self) == -1);
+  assert(errno == EINVAL);
+  assert(osp3_self_stats_reset(dev, OSP3_SELF_PROCESS) == 0);
+  errno = 0;
+  assert(osp3_self_stats_get(dev, NULL) == -1);
+  assert(errno == EINVAL);
+  assert(osp3_close(dev) == 0);
+}
+
+static void test_osp3_self_stats_mem(osp3_self_scope scope) {
+  static const char* const lines[] = { test_log1, test_log2, test_log3, test_log4 };
+  char data[4 * OSP3_LOG_PROTOCOL_SIZE];
+  unsigned char buf[OSP3_LOG_PROTOCOL_SIZE + 1];
+  osp3_self_stats self;
+  osp3_device* dev;
+  size_t transferred;
+  for (size_t i = 0; i < 4; i++) {
+    memcpy(&data[i * OSP3_LOG_PROTOCOL_SIZE], lines[i], OSP3_LOG_PROTOCOL_SIZE);
+  }
+  assert((dev = osp3_open_mem(data, sizeof(data), 0)) != NULL);
+  // Only lines after the reset count.
+  assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == 0);
+  if (osp3_self_stats_reset(dev, scope) < 0) {
+    // Per-thread usage isn't available on all platforms.
+    assert(scope == OSP3_SELF_THREAD && errno == ENOTSUP);
+    assert(osp3_close(dev) == 0);
+    return;
+  }
+  for (size_t i = 1; i < 4; i++) {
+    assert(osp3_read_line(dev, buf, sizeof(buf), &transferred, 0) == 0);
+  }
+  assert(osp3_self_stats_get(dev, &self) == 0);
+  assert(self.lines == 3);
+  assert(self.elapsed_ns > 0);
+  // Can't use more CPU time than elapsed time on one thread.
+  assert(scope != OSP3_SELF_THREAD || self.cpu_ns <= self.elapsed_ns);
+  assert(osp3_close(dev) == 0);
+}
+
 static void test_osp3_log_checksum_bad(void) {
   uint8_t cs8_2s = 0;
   uint8_t cs8_xor = 0;
@@ -187,17 +911,131 @@ static void test_osp3_log_parse(void) {
   assert(osp3_log_parse(test_log_no_newline, sizeof(test_log_no_newline), &log_entry) == 0);
 }
 
+static void test_osp3_log_format_bad(void) {
+  osp3_log_entry log_entry;
+  char log[OSP3_LOG_PROTOCOL_SIZE];
+  memset(&log_entry, 0, sizeof(log_entry));
+  // NULL arguments.
+  errno = 0;
+  assert(osp3_log_format(NULL, log) == -1);
+  assert(errno == EINVAL);
+  errno = 0;
+  assert(osp3_log_format(&log_entry, NULL) == -1);
+  assert(errno == EINVAL);
+  // Values too large for their fields.
+  log_entry.mA_in = 10000;
+  errno = 0;
+  assert(osp3_log_format(&log_entry, log) == -1);
+  assert(errno == ERANGE);
+  log_entry.mA_in = 0;
+  log_entry.intr_1 = 0x100;
+  errno = 0;
+  assert(osp3_log_format(&log_entry, log) == -1);
+  assert(errno == ERANGE);
+}
+
+static uint32_t test_rand(uint32_t* state) {
+  // xorshift32
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+static void test_osp3_log_format(void) {
+  osp3_log_entry log_entry;
+  osp3_log_entry parsed;
+  // Extra byte for the null terminator required by the parser.
+  char log[OSP3_LOG_PROTOCOL_SIZE + 1] = { 0 };
+  static const char* test_logs[] = { test_log1, test_log2, test_log3, test_log4 };
+  // Existing logs are reproduced exactly, including checksums with hexadecimal letters.
+  for (size_t i = 0; i < sizeof(test_logs) / sizeof(test_logs[0]); i++) {
+    assert(osp3_log_parse(test_logs[i], OSP3_LOG_PROTOCOL_SIZE + 1, &log_entry) == 0);
+    // Checksum fields are ignored.
+    log_entry.checksum8_2s_compl = 0;
+    log_entry.checksum8_xor = 0;
+    assert(osp3_log_format(&log_entry, log) == 0);
+    assert(!memcmp(log, test_logs[i], OSP3_LOG_PROTOCOL_SIZE));
+    assert(log[OSP3_LOG_PROTOCOL_SIZE] == '\0');
+  }
+  // Random entries (including maximum field values) round-trip through the parser.
+  // Compared with memcmp, so clear any padding.
+  memset(&log_entry, 0, sizeof(log_entry));
+  memset(&parsed, 0, sizeof(parsed));
+  uint32_t rng = 1;
+  for (int i = 0; i < 100000; i++) {
+    log_entry.ms = i == 0 ? 9999999999ul : (unsigned long) test_rand(&rng) * 2;
+    log_entry.mV_in = i == 0 ? 99999 : test_rand(&rng) % 100000;
+    log_entry.mA_in = i == 0 ? 9999 : test_rand(&rng) % 10000;
+    log_entry.mW_in = i == 0 ? 99999 : test_rand(&rng) % 100000;
+    log_entry.onoff_in = i == 0 ? 9 : test_rand(&rng) % 2;
+    log_entry.mV_0 = test_rand(&rng) % 100000;
+    log_entry.mA_0 = test_rand(&rng) % 10000;
+    log_entry.mW_0 = test_rand(&rng) % 100000;
+    log_entry.onoff_0 = test_rand(&rng) % 2;
+    log_entry.intr_0 = i == 0 ? 0xFF : test_rand(&rng) % 0x100;
+    log_entry.mV_1 = test_rand(&rng) % 100000;
+    log_entry.mA_1 = test_rand(&rng) % 10000;
+    log_entry.mW_1 = test_rand(&rng) % 100000;
+    log_entry.onoff_1 = test_rand(&rng) % 2;
+    log_entry.intr_1 = test_rand(&rng) % 0x100;
+    assert(osp3_log_format(&log_entry, log) == 0);
+    assert(osp3_log_parse(log, sizeof(log), &parsed) == 0);
+    assert(osp3_log_checksum_test(log, sizeof(log), parsed.checksum8_2s_compl, parsed.checksum8_xor) == 0);
+    log_entry.checksum8_2s_compl = parsed.checksum8_2s_compl;
+    log_entry.checksum8_xor = parsed.checksum8_xor;
+    assert(!memcmp(&log_entry, &parsed, sizeof(parsed)));
+  }
+}
+
 int main(void) {
   test_osp3_open_path_bad();
+  test_osp3_open_mem_bad();
+  test_osp3_open_fd_bad();
+  test_osp3_get_fd_bad();
   test_osp3_close_bad();
   test_osp3_flush_bad();
   test_osp3_read_bad();
   test_osp3_read_line_bad();
+  test_osp3_read_line_resync_bad();
+  // Byte-at-a-time, odd, and device packet sizes.
+  test_osp3_read_mem(1);
+  test_osp3_read_mem(7);
+  test_osp3_read_mem(OSP3_W_MAX_PACKET_SIZE);
+  test_osp3_read_line_mem(1);
+  test_osp3_read_line_mem(7);
+  test_osp3_read_line_mem(OSP3_W_MAX_PACKET_SIZE);
+  test_osp3_read_line_resync_mem();
+  test_osp3_read_line_resync_fd();
+  test_osp3_set_coalesce_bad();
+  test_osp3_set_coalesce_mem();
+  test_osp3_set_coalesce_timeout();
+  test_osp3_wait_bad();
+  test_osp3_read_line_fd();
+  test_osp3_open_into_bad();
+  test_osp3_read_line_mem_into();
+  test_osp3_read_line_fd_into();
+  test_osp3_open_ex_bad();
+  test_osp3_get_line_time_mem();
+  test_osp3_open_follow_bad();
+#ifdef __linux__
+  test_osp3_read_line_follow();
+#endif
+  test_osp3_get_stats_bad();
+  test_osp3_get_stats_mem();
+  test_osp3_latency_bad();
+  test_osp3_latency_mem();
+  test_osp3_self_stats_bad();
+  test_osp3_self_stats_mem(OSP3_SELF_PROCESS);
+  test_osp3_self_stats_mem(OSP3_SELF_THREAD);
   test_osp3_log_checksum_bad();
   test_osp3_log_checksum();
   test_osp3_log_checksum_test_bad();
   test_osp3_log_checksum_test();
   test_osp3_log_parse_bad();
   test_osp3_log_parse();
+  test_osp3_log_format_bad();
+  test_osp3_log_format();
+  test_osp3_log_verify();
   return 0;
 }
@@ -4,21 +4,33 @@
  * @author Connor Imes
  * @date 2024-03-27
  */
+#ifdef __linux__
+// For splice.
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#endif
 #include <errno.h>
 #include <getopt.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <osp3.h>
 
 #define PATH_DEFAULT "/dev/ttyUSB0"
 
 #define TIMEOUT_MS_DEFAULT 0
 
+// Read/write buffer size, in bytes - a device delivers at most a packet per read, but may have more data queued.
+#define DUMP_BUF_SIZE (64 * 1024)
+
 static const char* path = PATH_DEFAULT;
 static unsigned int baud = OSP3_BAUD_DEFAULT;
 static unsigned int timeout_ms = TIMEOUT_MS_DEFAULT;
 static volatile int running = 1;
+static int use_splice = 1;
 
 static const char short_options[] = "hp:b:t:";
 static const struct option long_options[] = {
@@ -26,6 +38,8 @@ static const struct option long_options[] = {
   {"path",      required_argument, NULL, 'p'},
   {"baud",      required_argument, NULL, 'b'},
   {"timeout",   required_argument, NULL, 't'},
+  // Long-only options.
+  {"no-splice", no_argument,       &use_splice, 0},
   {0, 0, 0, 0}
 };
 
@@ -39,7 +53,8 @@ static void print_usage(int exit_code) {
           "  -p, --path=FILE          Device path (default: %s)\n"
           "  -b, --baud=RATE          Device baud rate (default: %u)\n"
           "  -t, --timeout=MS         Read timeout in milliseconds (default: %u)\n"
-          "                           Use 0 for blocking read\n",
+          "                           Use 0 for blocking read\n"
+          "  --no-splice              Copy data through user space instead of using splice (Linux)\n",
           PATH_DEFAULT, OSP3_BAUD_DEFAULT, TIMEOUT_MS_DEFAULT);
   exit(exit_code);
 }
@@ -60,6 +75,9 @@ static void parse_args(int argc, char** argv) {
       case 't':
         timeout_ms = (unsigned int) atoi(optarg);
         break;
+      case 0:
+        // Long-only option.
+        break;
       case '?':
       default:
         print_usage(1);
@@ -87,35 +105,125 @@ static void shandle(int sig) {
   }
 }
 
+static int write_all(const unsigned char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(STDOUT_FILENO, buf, len);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    buf += written;
+    len -= (size_t) written;
+  }
+  return 0;
+}
+
+static int report_read_error(const char* what) {
+  if (!running) {
+    return 0;
+  }
+  if (errno == ETIME) {
+    fprintf(stderr, "Read timeout expired\n");
+  } else {
+    perror(what);
+  }
+  return 1;
+}
+
 static int osp3_dump(osp3_device* dev) {
-  unsigned char packet[OSP3_W_MAX_PACKET_SIZE] = { 0 };
+  static unsigned char buf[DUMP_BUF_SIZE];
   while (running) {
     size_t transferred = 0;
-    if (osp3_read(dev, packet, sizeof(packet), &transferred, timeout_ms) < 0) {
-      if (!running) {
-        return 0;
+    if (osp3_read(dev, buf, sizeof(buf), &transferred, timeout_ms) < 0) {
+      return report_read_error("osp3_read");
+    }
+    if (transferred == 0) {
+      // Disconnected.
+      errno = ENODATA;
+      return report_read_error("osp3_read");
+    }
+    if (write_all(buf, transferred) < 0) {
+      perror("write");
+      return 1;
+    }
+  }
+  return 0;
+}
+
+#ifdef __linux__
+// Move data from the device to stdout in the kernel, through a pipe unless stdout is already one.
+// Returns -1 to fall back to copying if the device can't be spliced from, e.g., the file types don't support it.
+static int osp3_dump_splice(osp3_device* dev) {
+  struct stat st;
+  int pfd[2] = { -1, -1 };
+  int ret = 0;
+  const int fd = osp3_get_fd(dev);
+  if (fd < 0 || fstat(STDOUT_FILENO, &st) < 0) {
+    return -1;
+  }
+  const int direct = S_ISFIFO(st.st_mode);
+  if (!direct && pipe(pfd) < 0) {
+    return -1;
+  }
+  const int out = direct ? STDOUT_FILENO : pfd[1];
+  while (running && ret == 0) {
+    if (osp3_wait(dev, timeout_ms) < 0) {
+      ret = report_read_error("osp3_wait");
+      break;
+    }
+    // The device is non-blocking, but the output may not be.
+    ssize_t in = splice(fd, NULL, out, NULL, DUMP_BUF_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (in < 0) {
+      if (errno == EAGAIN && direct) {
+        // The device was readable, so stdout is probably full - wait for it to drain rather than spin.
+        struct pollfd pout = { .fd = STDOUT_FILENO, .events = POLLOUT };
+        if (poll(&pout, 1, -1) < 0 && errno != EINTR) {
+          perror("poll");
+          ret = 1;
+          break;
+        }
+        continue;
       }
-      if (errno == ETIME) {
-        fprintf(stderr, "Read timeout expired\n");
-      } else {
-        perror("osp3_read");
+      if (errno == EAGAIN || errno == EINTR) {
+        continue;
       }
-      return 1;
+      // Unsupported for these file types, or a device error - let reads report the latter.
+      ret = -1;
+      break;
     }
-    for (size_t i = 0; i < transferred; i++) {
-      putchar((const char) packet[i]);
+    if (in == 0) {
+      // Disconnected.
+      errno = ENODATA;
+      ret = report_read_error("splice");
+      break;
+    }
+    // Drain the pipe - once data is in it, it's too late to fall back.
+    while (!direct && in > 0) {
+      ssize_t written = splice(pfd[0], NULL, STDOUT_FILENO, NULL, (size_t) in, SPLICE_F_MOVE);
+      if (written < 0 && errno == EINTR) {
+        continue;
+      }
+      if (written <= 0) {
+        perror("splice");
+        ret = 1;
+        break;
+      }
+      in -= written;
     }
   }
-  return 0;
+  if (!direct) {
+    close(pfd[0]);
+    close(pfd[1]);
+  }
+  return ret;
 }
+#endif
 
 int main(int argc, char** argv) {
   osp3_device* dev;
-  int ret;
-
-  // Flushing lines improves streaming performance when stdout is non-interactive, e.g., piped to another process.
-  // This enables better (soft) real-time pipeline processing.
-  setlinebuf(stdout);
+  int ret = -1;
 
   signal(SIGINT, shandle);
   parse_args(argc, argv);
@@ -125,7 +233,15 @@ int main(int argc, char** argv) {
     return 1;
   }
 
-  ret = osp3_dump(dev);
+#ifdef __linux__
+  if (use_splice) {
+    ret = osp3_dump_splice(dev);
+  }
+#endif
+  if (ret < 0) {
+    // Splice is disabled or unsupported for these file types.
+    ret = osp3_dump(dev);
+  }
 
   if (osp3_close(dev)) {
     perror("Failed to close ODROID Smart Power 3 connection");
@@ -0,0 +1,150 @@
+/**
+ * Generate synthetic ODROID Smart Power 3 log entries.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <osp3.h>
+
+// Lines per write - large writes amortize syscall overhead.
+#define BATCH_LINES 8192
+
+static unsigned long count = 0;
+static unsigned int interval_ms = OSP3_INTERVAL_MS_DEFAULT;
+static unsigned long ms_start = 0;
+static uint64_t seed = 1;
+
+static const char short_options[] = "hn:i:m:S:";
+static const struct option long_options[] = {
+  {"help",      no_argument,       NULL, 'h'},
+  {"num",       required_argument, NULL, 'n'},
+  {"interval",  required_argument, NULL, 'i'},
+  {"ms-start",  required_argument, NULL, 'm'},
+  {"seed",      required_argument, NULL, 'S'},
+  {0, 0, 0, 0}
+};
+
+__attribute__ ((noreturn))
+static void print_usage(int exit_code) {
+  fprintf(exit_code ? stderr : stdout,
+          "Generate synthetic ODROID Smart Power 3 log entries as fast as possible.\n\n"
+          "Usage: osp3-gen [OPTION]...\n"
+          "Options:\n"
+          "  -h, --help               Print this message and exit\n"
+          "  -n, --num=N              Stop after N log entries (default: unlimited)\n"
+          "  -i, --interval=MS        Logging interval between entry timestamps (default: %u)\n"
+          "  -m, --ms-start=MS        Timestamp of the first entry (default: 0)\n"
+          "  -S, --seed=N             Random number generator seed (default: 1)\n",
+          OSP3_INTERVAL_MS_DEFAULT);
+  exit(exit_code);
+}
+
+static void parse_args(int argc, char** argv) {
+  int c;
+  while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+    switch (c) {
+      case 'h':
+        print_usage(0);
+        break;
+      case 'n':
+        count = strtoul(optarg, NULL, 0);
+        break;
+      case 'i':
+        interval_ms = (unsigned int) atoi(optarg);
+        break;
+      case 'm':
+        ms_start = strtoul(optarg, NULL, 0);
+        break;
+      case 'S':
+        seed = strtoull(optarg, NULL, 0);
+        break;
+      case '?':
+      default:
+        print_usage(1);
+        break;
+    }
+  }
+}
+
+static uint64_t rand64(uint64_t* state) {
+  // xorshift64
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+static void gen_entry(osp3_log_entry* e, unsigned long ms, uint64_t* rng) {
+  // One random draw supplies the noise for every field.
+  uint64_t r = rand64(rng);
+  e->ms = ms;
+  e->mV_in = 15280 + (unsigned int) (r & 0x1F);
+  e->onoff_0 = 1;
+  e->mV_0 = 5080 + (unsigned int) ((r >> 5) & 0x1F);
+  e->mA_0 = 200 + (unsigned int) ((r >> 10) & 0x7FF);
+  e->mW_0 = e->mV_0 * e->mA_0 / 1000;
+  e->intr_0 = 0;
+  e->onoff_1 = 1;
+  e->mV_1 = 11990 + (unsigned int) ((r >> 21) & 0x1F);
+  e->mA_1 = 140 + (unsigned int) ((r >> 26) & 0x1F);
+  e->mW_1 = e->mV_1 * e->mA_1 / 1000;
+  e->intr_1 = 0;
+  e->onoff_in = 1;
+  e->mW_in = (e->mW_0 + e->mW_1) * 10 / 9 + 350;
+  e->mA_in = e->mW_in * 1000 / e->mV_in;
+}
+
+static int write_all(const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(STDOUT_FILENO, buf, len);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    buf += written;
+    len -= (size_t) written;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  static char buf[BATCH_LINES * OSP3_LOG_PROTOCOL_SIZE];
+  osp3_log_entry entry = { 0 };
+  unsigned long ms;
+  unsigned long n = 0;
+
+  parse_args(argc, argv);
+  if (seed == 0) {
+    seed = 1;
+  }
+
+  ms = ms_start;
+  while (count == 0 || n < count) {
+    size_t lines = 0;
+    while (lines < BATCH_LINES && (count == 0 || n < count)) {
+      gen_entry(&entry, ms, &seed);
+      if (osp3_log_format(&entry, &buf[lines * OSP3_LOG_PROTOCOL_SIZE]) < 0) {
+        // Wrap timestamps that exceed the field width.
+        ms = 0;
+        continue;
+      }
+      ms += interval_ms;
+      lines++;
+      n++;
+    }
+    if (write_all(buf, lines * OSP3_LOG_PROTOCOL_SIZE) < 0) {
+      perror("write");
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -7,10 +7,16 @@
 #include <assert.h>
 #include <errno.h>
 #include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <time.h>
 #include <unistd.h>
 #include <osp3.h>
 
@@ -22,14 +28,254 @@
 // Much bigger than anything an OSP3 should produce.
 #define OSP3_LINE_LEN_MAX 1024
 
-static int path_set = 0;
-static const char* path = PATH_DEFAULT;
+// Output batch size, in bytes - large writes amortize syscall overhead.
+#define OUT_BUF_SIZE (64 * 1024)
+
+// Devices that can be polled at once.
+#define DEVICES_MAX 8
+
+// Joined rows have a host timestamp and columns for every device.
+#define FIELDS_MAX (2 + DEVICES_MAX * COL_COUNT)
+
+// Log entries buffered per device for merging - bounds how long a quiet device can hold back the others.
+#define MERGE_QUEUE_LEN 64
+
+#define MERGE_WINDOW_MS_DEFAULT 100
+
+// How fast a device's clock may drift from the host's, in parts per million (crystals are typically within 50).
+#define CLOCK_DRIFT_PPM 100
+
+// Pipeline queue depth, in lines - 4 seconds of entries at the fastest logging interval.
+#define PIPELINE_SLOTS_DEFAULT 1024
+// With a detected interval, the default depth covers the same time, within limits.
+#define PIPELINE_SLOTS_MIN 16
+
+static const char header[] =
+  "ms,"
+  "mV_in,mA_in,mW_in,onoff_in,"
+  "mV_0,mA_0,mW_0,onoff_0,interrupts_0,"
+  "mV_1,mA_1,mW_1,onoff_1,interrupts_1,"
+  "CheckSum8_2s_Complement,CheckSum8_Xor\n";
+
+typedef enum output_format {
+  // The device's lines, verbatim.
+  FORMAT_RAW,
+  FORMAT_CSV,
+  FORMAT_TSV,
+  FORMAT_JSONL,
+  FORMAT_BINARY,
+} output_format;
+
+static const char* const format_names[] = {
+  [FORMAT_RAW] = "raw",
+  [FORMAT_CSV] = "csv",
+  [FORMAT_TSV] = "tsv",
+  [FORMAT_JSONL] = "jsonl",
+  [FORMAT_BINARY] = "binary",
+};
+
+typedef enum column_id {
+  COL_MS,
+  COL_MV_IN,
+  COL_MA_IN,
+  COL_MW_IN,
+  COL_ONOFF_IN,
+  COL_MV_0,
+  COL_MA_0,
+  COL_MW_0,
+  COL_ONOFF_0,
+  COL_INTR_0,
+  COL_MV_1,
+  COL_MA_1,
+  COL_MW_1,
+  COL_ONOFF_1,
+  COL_INTR_1,
+  COL_CS8_2S,
+  COL_CS8_XOR,
+  // Not from the device: the device's index, and when its log entry was received.
+  COL_DEV,
+  COL_HOST_US,
+  COL_COUNT
+} column_id;
+
+static const struct {
+  const char* name;
+  // The name in SI units, or NULL if the column has no unit.
+  const char* name_si;
+} column_info[COL_COUNT] = {
+  [COL_MS] = { "ms", NULL },
+  [COL_MV_IN] = { "mV_in", "V_in" },
+  [COL_MA_IN] = { "mA_in", "A_in" },
+  [COL_MW_IN] = { "mW_in", "W_in" },
+  [COL_ONOFF_IN] = { "onoff_in", NULL },
+  [COL_MV_0] = { "mV_0", "V_0" },
+  [COL_MA_0] = { "mA_0", "A_0" },
+  [COL_MW_0] = { "mW_0", "W_0" },
+  [COL_ONOFF_0] = { "onoff_0", NULL },
+  [COL_INTR_0] = { "interrupts_0", NULL },
+  [COL_MV_1] = { "mV_1", "V_1" },
+  [COL_MA_1] = { "mA_1", "A_1" },
+  [COL_MW_1] = { "mW_1", "W_1" },
+  [COL_ONOFF_1] = { "onoff_1", NULL },
+  [COL_INTR_1] = { "interrupts_1", NULL },
+  [COL_CS8_2S] = { "CheckSum8_2s_Complement", NULL },
+  [COL_CS8_XOR] = { "CheckSum8_Xor", NULL },
+  [COL_DEV] = { "dev", NULL },
+  [COL_HOST_US] = { "host_us", NULL },
+};
+
+enum follow_mode {
+  FOLLOW_START = 1,
+  FOLLOW_END,
+};
+
+// An output field - a column from a particular device, or from a row's device if `dev < 0`.
+typedef struct field {
+  column_id col;
+  int dev;
+} field;
+
+static const char* paths[DEVICES_MAX];
+static size_t npaths = 0;
+static int path_stdin = 0;
+// Follow a growing file: 0 (disabled), FOLLOW_START, or FOLLOW_END.
+static int follow = 0;
 static unsigned int baud = OSP3_BAUD_DEFAULT;
+// Detect the baud rate and logging interval, and derive settings that weren't explicitly set.
+static int probe = 0;
 static unsigned int timeout_ms = TIMEOUT_MS_DEFAULT;
+static int timeout_set = 0;
+static int predict = 0;
+// Coalesce reads into batches, adding up to this much latency (0 disables).
+static unsigned int coalesce_ms = 0;
+// Real-time settings for the reading thread.
+static osp3_realtime realtime = { .cpu = -1, .fifo_priority = 0, .lock_memory = 0 };
+static int lock_memory = 0;
 static volatile int running = 1;
 static int count = 0;
 static int parse = 1;
 static int checksum = 1;
+static int latency = 0;
+static int stats = 0;
+static int self_stats = 0;
+static unsigned int stats_interval_s = 0;
+// Output flush policy - 0 disables a limit; if none are set, every line is flushed.
+static unsigned long flush_lines = 0;
+static size_t flush_bytes = 0;
+static unsigned int flush_ms = 0;
+static output_format format = FORMAT_RAW;
+static int format_set = 0;
+static column_id columns[COL_COUNT];
+static size_t ncolumns = 0;
+static int columns_set = 0;
+static int si_units = 0;
+static field fields[FIELDS_MAX];
+static size_t nfields = 0;
+// Maximum rendered length of a row.
+static size_t row_len_max = OSP3_LINE_LEN_MAX;
+// Pipeline queue depth - 0 disables pipelining.
+static size_t pipeline_slots = 0;
+static int pipeline_slots_set = 0;
+// Latency marks apply to the most recently read line, so aren't meaningful when stages run concurrently.
+static int latency_marks = 0;
+static uint64_t start_ns = 0;
+// Multiple devices: join entries into rows per time bucket (if not 0), after waiting up to a window for stragglers.
+static unsigned int align_ms = 0;
+static unsigned int merge_window_ms = MERGE_WINDOW_MS_DEFAULT;
+
+// Lines are read directly into the output buffer, and only committed if they're valid.
+static struct {
+  char buf[OUT_BUF_SIZE];
+  size_t len;
+  unsigned long lines;
+  // When the oldest unflushed line was committed.
+  uint64_t first_ns;
+  // Whether the most recently read line is unflushed, for latency measurement.
+  int mark;
+} out;
+
+typedef struct merge_row {
+  // When the device took the sample, estimated in host time.
+  uint64_t host_ns;
+  osp3_log_entry entry;
+  // The device's line, for raw output.
+  size_t len;
+  char line[OSP3_LOG_PROTOCOL_SIZE + 1];
+} merge_row;
+
+typedef struct poll_device {
+  osp3_device* dev;
+  const char* path;
+  int first;
+  // When the device's most recent line was received.
+  uint64_t last_ns;
+  // Host time at device time 0, from the smallest delay observed - jitter only ever makes entries arrive late.
+  int64_t offset_ns;
+  uint64_t offset_updated_ns;
+  unsigned long ms_prev;
+  int offset_valid;
+  // Entries waiting to be merged, in device (and so host) time order.
+  merge_row queue[MERGE_QUEUE_LEN];
+  size_t queue_head;
+  size_t queue_len;
+} poll_device;
+
+static poll_device devices[DEVICES_MAX];
+static size_t ndevices = 0;
+
+typedef struct pipeline_slot {
+  uint64_t host_ns;
+  size_t len;
+  osp3_log_entry entry;
+  char line[OSP3_LINE_LEN_MAX + 1];
+} pipeline_slot;
+
+// In pipelined mode, the main thread only reads and verifies lines into a ring, a worker formats them, and a writer
+// outputs them.
+// Verifying stays on the reading thread, since it updates the device's counters, which have a single writer.
+// Each stage advances its own index, and slots pass through the stages in order, so they're never copied or locked.
+static struct {
+  pipeline_slot* slots;
+  size_t mask;
+  // The next slot to read into (main thread), format (worker), and write (writer).
+  _Atomic size_t head;
+  _Atomic size_t formatted;
+  _Atomic size_t tail;
+  _Atomic int read_done;
+  _Atomic int format_done;
+  // Stop reading early, e.g., when output fails.
+  _Atomic int stop;
+  _Atomic int write_failed;
+  // Set while each stage waits, so the previous stage only takes the lock to wake a stage that's asleep.
+  _Atomic int read_waiting;
+  _Atomic int format_waiting;
+  _Atomic int write_waiting;
+  // Only used to sleep when idle - never held while reading, verifying, or writing.
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  // Lines dropped by the reader because the ring was full, and the deepest the ring has been.
+  _Atomic uint64_t dropped;
+  _Atomic size_t depth_max;
+} pl = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+
+enum long_only_options {
+  OPT_STATS = 256,
+  OPT_FLUSH_LINES,
+  OPT_FLUSH_BYTES,
+  OPT_FLUSH_MS,
+  OPT_PIPELINE,
+  OPT_FORMAT,
+  OPT_COLUMNS,
+  OPT_ALIGN,
+  OPT_MERGE_WINDOW,
+  OPT_FOLLOW,
+  OPT_COALESCE,
+  OPT_CPU,
+  OPT_FIFO,
+};
 
 static const char short_options[] = "hp::b:t:n:";
 static const struct option long_options[] = {
@@ -41,6 +287,24 @@ static const struct option long_options[] = {
   // Long-only options.
   {"no-parse",    no_argument,       &parse, 0},
   {"no-checksum", no_argument,       &checksum, 0},
+  {"latency",     no_argument,       &latency, 1},
+  {"stats",       required_argument, NULL, OPT_STATS},
+  {"self-stats",  no_argument,       &self_stats, 1},
+  {"flush-lines", required_argument, NULL, OPT_FLUSH_LINES},
+  {"flush-bytes", required_argument, NULL, OPT_FLUSH_BYTES},
+  {"flush-ms",    required_argument, NULL, OPT_FLUSH_MS},
+  {"pipeline",    optional_argument, NULL, OPT_PIPELINE},
+  {"format",      required_argument, NULL, OPT_FORMAT},
+  {"columns",     required_argument, NULL, OPT_COLUMNS},
+  {"si",          no_argument,       &si_units, 1},
+  {"align",       required_argument, NULL, OPT_ALIGN},
+  {"merge-window", required_argument, NULL, OPT_MERGE_WINDOW},
+  {"follow",      optional_argument, NULL, OPT_FOLLOW},
+  {"predict",     no_argument,       &predict, 1},
+  {"coalesce",    required_argument, NULL, OPT_COALESCE},
+  {"cpu",         required_argument, NULL, OPT_CPU},
+  {"fifo",        required_argument, NULL, OPT_FIFO},
+  {"mlock",       no_argument,       &lock_memory, 1},
   {0, 0, 0, 0}
 };
 
@@ -52,17 +316,93 @@ static void print_usage(int exit_code) {
           "Options:\n"
           "  -h, --help               Print this message and exit\n"
           "  -p, --path=FILE          Device path (default: %s);\n"
-          "                           No FILE, \"\", or \"-\" uses standard input\n"
-          "  -b, --baud=RATE          Device baud rate (default: %u)\n"
+          "                           No FILE, \"\", or \"-\" uses standard input;\n"
+          "                           Repeat to merge log entries from up to %u devices\n"
+          "  -b, --baud=RATE          Device baud rate (default: %u), or \"auto\" to detect it\n"
+          "                           and the logging interval, deriving the read timeout and\n"
+          "                           pipeline queue depth (unless set)\n"
           "  -t, --timeout=MS         Read timeout in milliseconds (default: %u)\n"
           "                           Use 0 for blocking read\n"
           "  -n, --num=N              Stop after N log entries\n"
           "  --no-parse               Disable log entry parsing verification\n"
-          "  --no-checksum            Disable log entry checksum verification\n",
-          PATH_DEFAULT, OSP3_BAUD_DEFAULT, TIMEOUT_MS_DEFAULT);
+          "  --no-checksum            Disable log entry checksum verification\n"
+          "  --latency                Print line latency percentiles on exit\n"
+          "                           (requires a library built with OSP3_LATENCY)\n"
+          "  --stats=SEC              Print I/O and error counters every SEC seconds and on exit\n"
+          "                           (use 0 to only print on exit)\n"
+          "  --self-stats             Print this process's CPU time and context switches (total and\n"
+          "                           per log entry) on exit, to quantify its overhead\n"
+          "  --flush-lines=N          Flush output after N log entries\n"
+          "  --flush-bytes=N          Flush output after N bytes (at most %u)\n"
+          "  --flush-ms=MS            Flush output at most MS milliseconds after an entry is read\n"
+          "                           Without flush options, each log entry is flushed immediately\n"
+          "  --pipeline[=N]           Read, format, and write on separate threads, queueing up to N\n"
+          "                           log entries between them (default: %u)\n"
+          "  --format=FMT             One of: raw, csv, tsv, jsonl, binary (default: raw, or csv\n"
+          "                           with --columns, --si, or --align)\n"
+          "  --columns=LIST           Comma-separated columns to output (default: all, as named in\n"
+          "                           the raw header)\n"
+          "  --si                     Convert millivolts, milliamps, and milliwatts to V, A, and W\n"
+          "  --align=MS               Join log entries from all devices into one row per MS\n"
+          "                           milliseconds, instead of tagging rows with the device\n"
+          "  --merge-window=MS        Wait up to MS milliseconds for late log entries when merging\n"
+          "                           devices (default: %u)\n"
+          "  --follow[=WHERE]         Follow a growing file at the device path, like tail -F,\n"
+          "                           from its start (default) or end\n"
+          "  --predict                Sleep until each line is expected, instead of waking for\n"
+          "                           every packet\n"
+          "  --coalesce=MS            Read in batches, delaying log entries by up to MS\n"
+          "                           milliseconds (at most %u) to minimize wakeups; host times\n"
+          "                           are reconstructed from device times, and output is flushed\n"
+          "                           every MS milliseconds unless flush options are set\n"
+          "  --cpu=N                  Pin the reading thread to CPU N\n"
+          "  --fifo=PRIO              Run the reading thread with SCHED_FIFO priority PRIO\n"
+          "                           (usually requires privileges)\n"
+          "  --mlock                  Lock buffers in memory, so reading doesn't page fault\n",
+          PATH_DEFAULT, DEVICES_MAX, OSP3_BAUD_DEFAULT, TIMEOUT_MS_DEFAULT, OUT_BUF_SIZE - OSP3_LINE_LEN_MAX - 1,
+          PIPELINE_SLOTS_DEFAULT, MERGE_WINDOW_MS_DEFAULT, OSP3_COALESCE_MS_MAX);
   exit(exit_code);
 }
 
+static int parse_format(const char* name) {
+  for (size_t i = 0; i < sizeof(format_names) / sizeof(format_names[0]); i++) {
+    if (!strcmp(name, format_names[i])) {
+      format = (output_format) i;
+      format_set = 1;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+static int parse_columns(const char* list) {
+  columns_set = 1;
+  ncolumns = 0;
+  while (*list != '\0') {
+    const size_t len = strcspn(list, ",");
+    size_t i;
+    for (i = 0; i < COL_COUNT; i++) {
+      if (strlen(column_info[i].name) == len && !strncmp(list, column_info[i].name, len)) {
+        break;
+      }
+    }
+    if (i == COL_COUNT) {
+      fprintf(stderr, "Unknown column: %.*s\n", (int) len, list);
+      return -1;
+    }
+    if (ncolumns == COL_COUNT) {
+      fprintf(stderr, "Too many columns\n");
+      return -1;
+    }
+    columns[ncolumns++] = (column_id) i;
+    list += len;
+    if (*list == ',') {
+      list++;
+    }
+  }
+  return ncolumns > 0 ? 0 : -1;
+}
+
 static void parse_args(int argc, char** argv) {
   int c;
   while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
@@ -71,19 +411,91 @@ static void parse_args(int argc, char** argv) {
         print_usage(0);
         break;
       case 'p':
-        path_set = 1;
-        path = optarg;
+        if (optarg == NULL || optarg[0] == '\0' || !strcmp(optarg, "-")) {
+          path_stdin = 1;
+        } else if (npaths == DEVICES_MAX) {
+          fprintf(stderr, "Too many devices (at most %u)\n", DEVICES_MAX);
+          print_usage(1);
+        } else {
+          paths[npaths++] = optarg;
+        }
         break;
       case 'b':
-        baud = (unsigned int) atoi(optarg);
+        probe = !strcmp(optarg, "auto");
+        baud = probe ? 0 : (unsigned int) atoi(optarg);
         break;
       case 't':
         timeout_ms = (unsigned int) atoi(optarg);
+        timeout_set = 1;
         break;
       case 'n':
         count = 1;
         running = atoi(optarg);
         break;
+      case OPT_STATS:
+        stats = 1;
+        stats_interval_s = (unsigned int) atoi(optarg);
+        break;
+      case OPT_FLUSH_LINES:
+        flush_lines = strtoul(optarg, NULL, 0);
+        break;
+      case OPT_FLUSH_BYTES:
+        flush_bytes = strtoul(optarg, NULL, 0);
+        break;
+      case OPT_FLUSH_MS:
+        flush_ms = (unsigned int) atoi(optarg);
+        break;
+      case OPT_FORMAT:
+        if (parse_format(optarg) < 0) {
+          fprintf(stderr, "Unknown format: %s\n", optarg);
+          print_usage(1);
+        }
+        break;
+      case OPT_COLUMNS:
+        if (parse_columns(optarg) < 0) {
+          print_usage(1);
+        }
+        break;
+      case OPT_ALIGN:
+        align_ms = (unsigned int) atoi(optarg);
+        break;
+      case OPT_MERGE_WINDOW:
+        merge_window_ms = (unsigned int) atoi(optarg);
+        break;
+      case OPT_FOLLOW:
+        if (optarg == NULL || !strcmp(optarg, "start")) {
+          follow = FOLLOW_START;
+        } else if (!strcmp(optarg, "end")) {
+          follow = FOLLOW_END;
+        } else {
+          print_usage(1);
+        }
+        break;
+      case OPT_COALESCE:
+        coalesce_ms = (unsigned int) atoi(optarg);
+        if (coalesce_ms == 0 || coalesce_ms > OSP3_COALESCE_MS_MAX) {
+          print_usage(1);
+        }
+        break;
+      case OPT_CPU:
+        realtime.cpu = atoi(optarg);
+        if (realtime.cpu < 0) {
+          print_usage(1);
+        }
+        break;
+      case OPT_FIFO:
+        realtime.fifo_priority = atoi(optarg);
+        if (realtime.fifo_priority <= 0) {
+          print_usage(1);
+        }
+        break;
+      case OPT_PIPELINE:
+        pipeline_slots = optarg == NULL ? PIPELINE_SLOTS_DEFAULT : strtoul(optarg, NULL, 0);
+        pipeline_slots_set = optarg != NULL;
+        if (pipeline_slots == 0) {
+          print_usage(1);
+        }
+        break;
       case 0:
         // Long-only option.
         break;
@@ -114,139 +526,1176 @@ static void shandle(int sig) {
   }
 }
 
-static int stdin_wait(void) {
-  static const int fd = 0; // stdin
-  int ret = 0;
-  fd_set set;
-  FD_ZERO(&set);
-  FD_SET(fd, &set);
-  struct timespec ts_timeout = {
-    .tv_sec = timeout_ms / 1000,
-    .tv_nsec = (timeout_ms % 1000) * 1000 * 1000,
-  };
-  switch (pselect(fd + 1, &set, NULL, NULL, timeout_ms > 0 ? &ts_timeout : NULL, NULL)) {
-    case -1:
-      // failed
-      ret = -1;
+static int read_line(osp3_device* dev, unsigned char* buf, size_t len, size_t* transferred) {
+  size_t discarded = 0;
+  int ret = osp3_read_line_resync(dev, buf, len, transferred, &discarded, timeout_ms);
+  if (discarded > 0) {
+    fprintf(stderr, "Discarded oversize line data (%zu bytes)\n", discarded);
+  }
+  return ret;
+}
+
+static void print_stats(const osp3_device* dev, const char* label) {
+  osp3_stats st;
+  if (osp3_get_stats(dev, &st) == 0) {
+    fprintf(stderr, "%s: bytes_read=%llu reads=%llu timeouts=%llu lines=%llu lines_partial=%llu "
+            "lines_oversize=%llu resyncs=%llu bytes_discarded=%llu parse_failures=%llu checksum_failures=%llu "
+            "ms_gaps=%llu ms_resets=%llu\n", label,
+            (unsigned long long) st.bytes_read, (unsigned long long) st.reads, (unsigned long long) st.timeouts,
+            (unsigned long long) st.lines, (unsigned long long) st.lines_partial,
+            (unsigned long long) st.lines_oversize, (unsigned long long) st.resyncs,
+            (unsigned long long) st.bytes_discarded, (unsigned long long) st.parse_failures,
+            (unsigned long long) st.checksum_failures, (unsigned long long) st.ms_gaps,
+            (unsigned long long) st.ms_resets);
+    if (st.kernel_counters) {
+      fprintf(stderr, "%s: overruns=%llu buf_overruns=%llu frame_errors=%llu parity_errors=%llu "
+              "parse_failures_overrun=%llu checksum_failures_overrun=%llu\n", label,
+              (unsigned long long) st.overruns, (unsigned long long) st.buf_overruns,
+              (unsigned long long) st.frame_errors, (unsigned long long) st.parity_errors,
+              (unsigned long long) st.parse_failures_overrun, (unsigned long long) st.checksum_failures_overrun);
+    }
+  }
+  if (pipeline_slots > 0) {
+    const size_t head = atomic_load(&pl.head);
+    fprintf(stderr, "%s: pipeline_slots=%zu pipeline_depth=%zu pipeline_depth_max=%zu pipeline_dropped=%llu\n",
+            label, pl.mask + 1, head - atomic_load(&pl.tail), atomic_load(&pl.depth_max),
+            (unsigned long long) atomic_load(&pl.dropped));
+  }
+}
+
+static time_t now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static const char* column_name(column_id col) {
+  return si_units && column_info[col].name_si != NULL ? column_info[col].name_si : column_info[col].name;
+}
+
+static uint64_t column_value(const osp3_log_entry* e, column_id col) {
+  switch (col) {
+    case COL_MS: return e->ms;
+    case COL_MV_IN: return e->mV_in;
+    case COL_MA_IN: return e->mA_in;
+    case COL_MW_IN: return e->mW_in;
+    case COL_ONOFF_IN: return e->onoff_in;
+    case COL_MV_0: return e->mV_0;
+    case COL_MA_0: return e->mA_0;
+    case COL_MW_0: return e->mW_0;
+    case COL_ONOFF_0: return e->onoff_0;
+    case COL_INTR_0: return e->intr_0;
+    case COL_MV_1: return e->mV_1;
+    case COL_MA_1: return e->mA_1;
+    case COL_MW_1: return e->mW_1;
+    case COL_ONOFF_1: return e->onoff_1;
+    case COL_INTR_1: return e->intr_1;
+    case COL_CS8_2S: return e->checksum8_2s_compl;
+    case COL_CS8_XOR: return e->checksum8_xor;
+    case COL_COUNT:
+    default: return 0;
+  }
+}
+
+static const char digits2[] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+// Write a decimal integer two digits at a time, returning the length.
+static size_t fmt_u64(char* dst, uint64_t v) {
+  char tmp[20];
+  char* p = &tmp[sizeof(tmp)];
+  while (v >= 100) {
+    p -= 2;
+    memcpy(p, &digits2[(v % 100) * 2], 2);
+    v /= 100;
+  }
+  if (v >= 10) {
+    p -= 2;
+    memcpy(p, &digits2[v * 2], 2);
+  } else {
+    *--p = (char) ('0' + v);
+  }
+  const size_t len = (size_t) (&tmp[sizeof(tmp)] - p);
+  memcpy(dst, p, len);
+  return len;
+}
+
+// Write a value in thousandths as a fixed-point decimal (e.g., mV as V), returning the length.
+static size_t fmt_milli(char* dst, uint64_t v) {
+  size_t len = fmt_u64(dst, v / 1000);
+  const uint64_t frac = v % 1000;
+  dst[len++] = '.';
+  dst[len++] = (char) ('0' + frac / 100);
+  memcpy(&dst[len], &digits2[(frac % 100) * 2], 2);
+  return len + 2;
+}
+
+static size_t fmt_le(char* dst, uint64_t v, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    dst[i] = (char) (v >> (8 * i));
+  }
+  return size;
+}
+
+// Text that precedes each field's value (separators and JSON keys), and follows the last one.
+static struct {
+  char buf[FIELDS_MAX * 48];
+  size_t off[FIELDS_MAX + 1];
+  size_t len[FIELDS_MAX + 1];
+} fmt_text;
+
+static void fmt_text_add(size_t idx, const char* a, const char* b, const char* c) {
+  const size_t off = idx > 0 ? fmt_text.off[idx - 1] + fmt_text.len[idx - 1] : 0;
+  const int len = snprintf(&fmt_text.buf[off], sizeof(fmt_text.buf) - off, "%s%s%s", a, b, c);
+  fmt_text.off[idx] = off;
+  fmt_text.len[idx] = len > 0 ? (size_t) len : 0;
+}
+
+static void field_name(const field* f, char* name, size_t len) {
+  if (f->dev < 0) {
+    snprintf(name, len, "%s", column_name(f->col));
+  } else {
+    snprintf(name, len, "d%d_%s", f->dev, column_name(f->col));
+  }
+}
+
+static void format_init(void) {
+  const char* sep = format == FORMAT_BINARY ? "" : format == FORMAT_TSV ? "\t" : ",";
+  char name[40];
+  row_len_max = 0;
+  for (size_t i = 0; i < nfields; i++) {
+    if (format == FORMAT_JSONL) {
+      field_name(&fields[i], name, sizeof(name));
+      fmt_text_add(i, i == 0 ? "{\"" : ",\"", name, "\":");
+    } else {
+      fmt_text_add(i, i == 0 ? "" : sep, "", "");
+    }
+    // Values are at most 20 digits, plus a decimal point.
+    row_len_max += fmt_text.len[i] + 21;
+  }
+  if (format == FORMAT_RAW) {
+    // Any fields prefix the device's line.
+    fmt_text_add(nfields, nfields > 0 ? sep : "", "", "");
+    row_len_max += OSP3_LINE_LEN_MAX;
+  } else {
+    fmt_text_add(nfields, format == FORMAT_JSONL ? "}" : "", format == FORMAT_BINARY ? "" : "\n", "");
+  }
+  row_len_max += fmt_text.len[nfields];
+  if (row_len_max < OSP3_LINE_LEN_MAX) {
+    // Lines are read into the same space.
+    row_len_max = OSP3_LINE_LEN_MAX;
+  }
+}
+
+// Render a row's fields, returning the length (at most `row_len_max`).
+// `entries` is indexed by device - missing entries (NULL) are rendered as empty values (or null, in JSON).
+static size_t format_row(char* dst, const osp3_log_entry* const* entries, unsigned int dev, uint64_t host_us) {
+  size_t len = 0;
+  for (size_t i = 0; i <= nfields; i++) {
+    memcpy(&dst[len], &fmt_text.buf[fmt_text.off[i]], fmt_text.len[i]);
+    len += fmt_text.len[i];
+    if (i == nfields) {
       break;
-    case 0:
-      // timed out
-      errno = ETIME;
-      ret = -1;
+    }
+    const column_id col = fields[i].col;
+    const osp3_log_entry* e = entries[fields[i].dev < 0 ? dev : (unsigned int) fields[i].dev];
+    uint64_t v;
+    if (col == COL_DEV) {
+      v = dev;
+    } else if (col == COL_HOST_US) {
+      v = host_us;
+    } else if (e == NULL) {
+      if (format == FORMAT_JSONL) {
+        memcpy(&dst[len], "null", 4);
+        len += 4;
+      }
+      continue;
+    } else {
+      v = column_value(e, col);
+    }
+    if (format == FORMAT_BINARY) {
+      // Units are always milli-units.
+      len += fmt_le(&dst[len], v, col == COL_MS || col == COL_HOST_US ? sizeof(uint64_t) : sizeof(uint32_t));
+    } else if (si_units && column_info[col].name_si != NULL) {
+      len += fmt_milli(&dst[len], v);
+    } else {
+      len += fmt_u64(&dst[len], v);
+    }
+  }
+  return len;
+}
+
+// Microseconds since polling started.
+static uint64_t host_us(uint64_t ns) {
+  return ns > start_ns ? (ns - start_ns) / 1000 : 0;
+}
+
+static int out_flush(void) {
+  const char* buf = out.buf;
+  size_t len = out.len;
+  while (len > 0) {
+    ssize_t written = write(STDOUT_FILENO, buf, len);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    buf += written;
+    len -= (size_t) written;
+  }
+  out.len = 0;
+  out.lines = 0;
+  return 0;
+}
+
+// Get space to read a line or render a row into, flushing first if necessary.
+static char* out_reserve(void) {
+  if (sizeof(out.buf) - out.len < row_len_max + 1 && out_flush() < 0) {
+    return NULL;
+  }
+  return &out.buf[out.len];
+}
+
+// Commit a line that was read into reserved space, and report whether it's time to flush.
+static int out_commit(size_t len) {
+  if (out.lines == 0 && flush_ms > 0) {
+    out.first_ns = now_ns();
+  }
+  out.len += len;
+  out.lines++;
+  out.mark = 1;
+  return (flush_lines > 0 && out.lines >= flush_lines) ||
+         (flush_bytes > 0 && out.len >= flush_bytes) ||
+         (flush_ms > 0 && now_ns() - out.first_ns >= flush_ms * 1000000ull);
+}
+
+// Wait for data until the flush deadline of committed lines, if any, and return whether it's time to flush.
+static int out_deadline(const osp3_device* dev) {
+  if (out.lines == 0 || flush_ms == 0) {
+    return 0;
+  }
+  const uint64_t deadline = out.first_ns + flush_ms * 1000000ull;
+  const uint64_t now = now_ns();
+  if (now >= deadline) {
+    return 1;
+  }
+  // Round up - a 0 ms timeout would block indefinitely.
+  return osp3_wait(dev, (unsigned int) ((deadline - now + 999999) / 1000000)) < 0 && errno == ETIME;
+}
+
+static int out_deliver(osp3_device* dev) {
+  if (out_flush() < 0) {
+    perror("write");
+    return -1;
+  }
+  if (latency_marks && out.mark) {
+    // Only the most recently read line is measured.
+    osp3_latency_mark(dev, OSP3_LATENCY_MARK_DELIVERED);
+  }
+  out.mark = 0;
+  return 0;
+}
+
+// Returns 0 if the line is valid (or verification is disabled), otherwise reports the problem and returns -1.
+// The log entry is only populated if parsing is enabled.
+static int verify_line(osp3_device* dev, const char* line, size_t line_written, osp3_log_entry* log_entry) {
+  uint8_t cs8_2s;
+  uint8_t cs8_xor;
+  // If the line came from the serial port, we should expect `line_written == OSP3_LOG_PROTOCOL_SIZE`.
+  // However, a line from stdin may not include the '\r' prior to the '\n', so we'll try to be forgiving.
+  // Parsing and checksum should still drop bad messages (unless disabled, but that's the user being reckless).
+  if (parse && line_written < OSP3_LOG_PROTOCOL_SIZE - 1) {
+    fprintf(stderr, "Log entry parsing failed (too short): %s", line);
+    return -1;
+  }
+  if (parse && line_written > OSP3_LOG_PROTOCOL_SIZE) {
+    fprintf(stderr, "Log entry parsing failed (too long): %s", line);
+    return -1;
+  }
+  if (parse && checksum) {
+    // Also records the outcome in the device's counters.
+    switch (osp3_log_verify(dev, line, OSP3_LOG_PROTOCOL_SIZE, log_entry)) {
+      case 0:
+        return 0;
+      case 2:
+        osp3_log_checksum(line, OSP3_LOG_PROTOCOL_SIZE, &cs8_2s, &cs8_xor);
+        fprintf(stderr, "Log entry checksum failed (cs8_2s=%02x, cs8_xor=%02x): %s", cs8_2s, cs8_xor, line);
+        return -1;
+      default:
+        fprintf(stderr, "Log entry parsing failed (bad format): %s", line);
+        return -1;
+    }
+  }
+  if (parse && osp3_log_parse(line, OSP3_LOG_PROTOCOL_SIZE, log_entry)) {
+    fprintf(stderr, "Log entry parsing failed (bad format): %s", line);
+    return -1;
+  }
+  if (checksum && osp3_log_checksum(line, OSP3_LOG_PROTOCOL_SIZE, &cs8_2s, &cs8_xor)) {
+    fprintf(stderr, "Log entry checksum failed (cs8_2s=%02x, cs8_xor=%02x): %s", cs8_2s, cs8_xor, line);
+    return -1;
+  }
+  return 0;
+}
+
+static int out_header(void) {
+  const char sep = format == FORMAT_TSV ? '\t' : ',';
+  switch (format) {
+    case FORMAT_RAW:
+    case FORMAT_CSV:
+    case FORMAT_TSV:
+      for (size_t i = 0; i < nfields; i++) {
+        field_name(&fields[i], &out.buf[out.len], sizeof(out.buf) - out.len);
+        out.len += strlen(&out.buf[out.len]);
+        out.buf[out.len++] = i + 1 < nfields || format == FORMAT_RAW ? sep : '\n';
+      }
+      if (format == FORMAT_RAW) {
+        memcpy(&out.buf[out.len], header, sizeof(header) - 1);
+        out.len += sizeof(header) - 1;
+      }
       break;
+    case FORMAT_JSONL:
+    case FORMAT_BINARY:
     default:
-      ret = 0;
-      break;
+      // No header.
+      return 0;
   }
-  return ret;
+  if (out_flush() < 0) {
+    perror("write");
+    return -1;
+  }
+  return 0;
 }
 
-static int stdin_read_line(unsigned char* buf, size_t len, size_t* transferred) {
-  *transferred = 0;
-  while (running) {
-    if (stdin_wait() < 0) {
+// Read the next line to verify (NUL-terminated), periodically printing stats.
+// Returns 1 if a line was read, 0 if it should be skipped, or -1 to stop reading with the exit code in `ret`.
+static int poll_read_line(osp3_device* dev, int is_file, char* line, size_t* line_written, int* first, int* ret) {
+  static time_t stats_next = 0;
+  if (stats && stats_interval_s > 0) {
+    if (stats_next == 0) {
+      stats_next = now_s() + stats_interval_s;
+    } else if (now_s() >= stats_next) {
+      print_stats(dev, "stats");
+      stats_next += stats_interval_s;
+    }
+  }
+  *line_written = 0;
+  if (read_line(dev, (unsigned char*) line, OSP3_LINE_LEN_MAX, line_written) < 0) {
+    if (!running || (is_file && errno == ENODATA)) {
+      // Interrupted, or the end of the input.
+      *ret = 0;
       return -1;
     }
-    int c;
-    if ((c = getchar()) == EOF) {
-      break;
+    if (errno == ETIME) {
+      fprintf(stderr, "Read timeout expired\n");
+    } else {
+      perror("read_line");
     }
-    buf[(*transferred)] = (unsigned char) c;
-    (*transferred)++;
-    if (c == '\n') {
+    *ret = 1;
+    return -1;
+  }
+  // It's common for the first line to be incomplete - if so, silently drop it.
+  if (*first) {
+    *first = 0;
+    // For the edge case where `line_written == OSP3_LOG_PROTOCOL_SIZE - 1`, prefer the risk of dropping a good line
+    // over parsing failures below (but only for this first line).
+    if (*line_written < OSP3_LOG_PROTOCOL_SIZE) {
       return 0;
     }
-    if (*transferred == len) {
-      errno = ENOBUFS;
-      return -1;
+  }
+  assert(*line_written > 0);
+  assert(line[*line_written - 1] == '\n');
+  line[*line_written] = '\0';
+  return 1;
+}
+
+// Estimate when a device took a sample, in host time, from when its line arrived.
+static uint64_t align_entry(poll_device* d, unsigned long ms, uint64_t arrival_ns) {
+  const int64_t delay_ns = (int64_t) arrival_ns - (int64_t) ms * 1000000;
+  if (!d->offset_valid || ms < d->ms_prev) {
+    // The first entry, or the device was reset.
+    d->offset_ns = delay_ns;
+    d->offset_valid = 1;
+  } else {
+    // Allow the minimum to rise as fast as the device's clock could fall behind the host's.
+    d->offset_ns += (int64_t) ((arrival_ns - d->offset_updated_ns) / (1000000 / CLOCK_DRIFT_PPM));
+    if (delay_ns < d->offset_ns) {
+      d->offset_ns = delay_ns;
     }
   }
-  running = 0;
-  return -1;
+  d->offset_updated_ns = arrival_ns;
+  d->ms_prev = ms;
+  const int64_t ns = d->offset_ns + (int64_t) ms * 1000000;
+  return ns > 0 ? (uint64_t) ns : 0;
 }
 
-static int read_line(osp3_device* dev, unsigned char* buf, size_t len, size_t* transferred) {
-  return dev == NULL ? stdin_read_line(buf, len, transferred) : osp3_read_line(dev, buf, len, transferred, timeout_ms);
+// Apply real-time settings from the reading thread, after any other threads are started (so they don't inherit them).
+static int realtime_enter(osp3_device* dev) {
+  realtime.lock_memory = lock_memory;
+  if (realtime.cpu < 0 && realtime.fifo_priority == 0 && !lock_memory) {
+    return 0;
+  }
+  if (osp3_set_realtime(dev, &realtime) < 0) {
+    perror("osp3_set_realtime");
+    return -1;
+  }
+  // The output buffer and merge queues - pipeline slots are locked when allocated.
+  if (lock_memory && (mlock(&out, sizeof(out)) < 0 || mlock(devices, sizeof(devices)) < 0)) {
+    perror("mlock");
+    return -1;
+  }
+  return 0;
+}
+
+// When a sample was taken, in host time - coalesced lines arrive in batches, so their times are reconstructed.
+static uint64_t sample_ns(const osp3_log_entry* entry, uint64_t arrival_ns) {
+  return coalesce_ms > 0 ? align_entry(&devices[0], entry->ms, arrival_ns) : arrival_ns;
 }
 
-static int osp3_poll(osp3_device* dev) {
-  // Print header.
-  printf("ms,");
-  printf("mV_in,mA_in,mW_in,onoff_in,");
-  printf("mV_0,mA_0,mW_0,onoff_0,interrupts_0,");
-  printf("mV_1,mA_1,mW_1,onoff_1,interrupts_1,");
-  printf("CheckSum8_2s_Complement,CheckSum8_Xor\n");
-  osp3_log_entry log_entry;
+static int osp3_poll(osp3_device* dev, int is_file) {
   int first = 1;
-  uint8_t cs8_2s;
-  uint8_t cs8_xor;
+  int ret = 0;
+  if (out_header() < 0 || realtime_enter(dev) < 0) {
+    return 1;
+  }
   while (running) {
-    char line[OSP3_LINE_LEN_MAX + 1] = { 0 };
-    size_t line_written = 0;
-    if (read_line(dev, (unsigned char*) line, sizeof(line) - 1, &line_written) < 0) {
-      if (!running) {
-        return 0;
+    osp3_log_entry entry;
+    char* line;
+    size_t line_written;
+    if (out_deadline(dev) && out_deliver(dev) < 0) {
+      return 1;
+    }
+    if (!running) {
+      // Interrupted while waiting.
+      break;
+    }
+    if ((line = out_reserve()) == NULL) {
+      perror("write");
+      return 1;
+    }
+    out.mark = 0;
+    const int r = poll_read_line(dev, is_file, line, &line_written, &first, &ret);
+    if (r < 0) {
+      return ret;
+    }
+    if (r > 0 && verify_line(dev, line, line_written, &entry) == 0) {
+      if (format != FORMAT_RAW) {
+        // The entry is parsed, so the line can be overwritten.
+        const osp3_log_entry* entries[] = { &entry };
+        line_written = format_row(line, entries, 0, host_us(sample_ns(&entry, now_ns())));
+      }
+      if (latency_marks) {
+        osp3_latency_mark(dev, OSP3_LATENCY_MARK_PARSED);
+      }
+      if (out_commit(line_written) && out_deliver(dev) < 0) {
+        return 1;
+      }
+      if (count) {
+        running--;
       }
-      if (errno == ETIME) {
-        fprintf(stderr, "Read timeout expired\n");
+    }
+  }
+  return 0;
+}
+
+static void pipeline_notify(void) {
+  pthread_mutex_lock(&pl.lock);
+  pthread_cond_broadcast(&pl.cond);
+  pthread_mutex_unlock(&pl.lock);
+}
+
+// Sleep until `idx` moves past `seen`, the previous stage is done, or the deadline (if not 0) passes.
+static void pipeline_wait(const _Atomic size_t* idx, size_t seen, const _Atomic int* done, uint64_t deadline_ns) {
+  struct timespec ts;
+  if (deadline_ns > 0) {
+    // Condition variables use the realtime clock (monotonic isn't portable).
+    const uint64_t now = now_ns();
+    const uint64_t rel_ns = deadline_ns > now ? deadline_ns - now : 0;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += (time_t) (rel_ns / 1000000000ull);
+    ts.tv_nsec += (long) (rel_ns % 1000000000ull);
+    if (ts.tv_nsec >= 1000000000L) {
+      ts.tv_sec++;
+      ts.tv_nsec -= 1000000000L;
+    }
+  }
+  pthread_mutex_lock(&pl.lock);
+  while (atomic_load(idx) == seen && !atomic_load(done)) {
+    if (deadline_ns == 0) {
+      pthread_cond_wait(&pl.cond, &pl.lock);
+    } else if (pthread_cond_timedwait(&pl.cond, &pl.lock, &ts) == ETIMEDOUT) {
+      break;
+    }
+  }
+  pthread_mutex_unlock(&pl.lock);
+}
+
+static void* pipeline_format(void* arg) {
+  (void) arg;
+  size_t i = 0;
+  while (1) {
+    if (i == atomic_load(&pl.head)) {
+      if (atomic_load(&pl.read_done)) {
+        break;
+      }
+      atomic_store(&pl.format_waiting, 1);
+      pipeline_wait(&pl.head, i, &pl.read_done, 0);
+      atomic_store(&pl.format_waiting, 0);
+      continue;
+    }
+    pipeline_slot* slot = &pl.slots[i & pl.mask];
+    if (format != FORMAT_RAW) {
+      const osp3_log_entry* entries[] = { &slot->entry };
+      slot->len = format_row(slot->line, entries, 0, host_us(sample_ns(&slot->entry, slot->host_ns)));
+    }
+    atomic_store(&pl.formatted, ++i);
+    if (atomic_load(&pl.write_waiting)) {
+      pipeline_notify();
+    }
+  }
+  atomic_store(&pl.format_done, 1);
+  pipeline_notify();
+  return NULL;
+}
+
+static void* pipeline_write(void* arg) {
+  osp3_device* dev = (osp3_device*) arg;
+  size_t i = 0;
+  int failed = 0;
+  while (!failed) {
+    if (i == atomic_load(&pl.formatted)) {
+      if (atomic_load(&pl.format_done)) {
+        failed = out_deliver(dev) < 0;
+        break;
+      }
+      const uint64_t deadline_ns = out.lines > 0 && flush_ms > 0 ? out.first_ns + flush_ms * 1000000ull : 0;
+      if (deadline_ns > 0 && now_ns() >= deadline_ns) {
+        failed = out_deliver(dev) < 0;
       } else {
-        perror("read_line");
+        atomic_store(&pl.write_waiting, 1);
+        pipeline_wait(&pl.formatted, i, &pl.format_done, deadline_ns);
+        atomic_store(&pl.write_waiting, 0);
       }
-      return 1;
+      continue;
+    }
+    const pipeline_slot* slot = &pl.slots[i & pl.mask];
+    char* line = out_reserve();
+    if (line == NULL) {
+      perror("write");
+      failed = 1;
+      break;
+    }
+    memcpy(line, slot->line, slot->len);
+    failed = out_commit(slot->len) && out_deliver(dev) < 0;
+    atomic_store(&pl.tail, ++i);
+    if (atomic_load(&pl.read_waiting)) {
+      pipeline_notify();
+    }
+  }
+  if (failed) {
+    // Discard unwritten output and stop reading.
+    out.len = 0;
+    out.lines = 0;
+    atomic_store(&pl.write_failed, 1);
+    atomic_store(&pl.stop, 1);
+    pipeline_notify();
+  }
+  return NULL;
+}
+
+static int osp3_poll_pipeline(osp3_device* dev, int is_file) {
+  pthread_t formatter;
+  pthread_t writer;
+  char spare[OSP3_LINE_LEN_MAX + 1];
+  osp3_log_entry entry;
+  size_t slots = 1;
+  size_t head = 0;
+  int first = 1;
+  int ret = 0;
+  if (out_header() < 0) {
+    return 1;
+  }
+  while (slots < pipeline_slots) {
+    slots <<= 1;
+  }
+  if ((pl.slots = malloc(slots * sizeof(pipeline_slot))) == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  pl.mask = slots - 1;
+  if (lock_memory && mlock(pl.slots, slots * sizeof(pipeline_slot)) < 0) {
+    perror("mlock");
+    free(pl.slots);
+    return 1;
+  }
+  if ((errno = pthread_create(&formatter, NULL, pipeline_format, NULL)) != 0) {
+    perror("pthread_create");
+    free(pl.slots);
+    return 1;
+  }
+  if ((errno = pthread_create(&writer, NULL, pipeline_write, dev)) != 0) {
+    perror("pthread_create");
+    atomic_store(&pl.read_done, 1);
+    pipeline_notify();
+    pthread_join(formatter, NULL);
+    free(pl.slots);
+    return 1;
+  }
+  if (realtime_enter(dev) < 0) {
+    ret = 1;
+    atomic_store(&pl.stop, 1);
+  }
+  while (running && !atomic_load(&pl.stop)) {
+    size_t line_written;
+    if (is_file && head - atomic_load(&pl.tail) > pl.mask) {
+      // Standard input and files can't overrun, so wait for space instead of dropping lines.
+      atomic_store(&pl.read_waiting, 1);
+      pipeline_wait(&pl.tail, head - pl.mask - 1, &pl.stop, 0);
+      atomic_store(&pl.read_waiting, 0);
+      continue;
     }
-    // It's common for the first line to be incomplete - if so, silently drop it.
-    if (first) {
-      first = 0;
-      // For the edge case where `line_written == OSP3_LOG_PROTOCOL_SIZE - 1`, prefer the risk of dropping a good line
-      // over parsing failures below (but only for this first line).
-      if (line_written < OSP3_LOG_PROTOCOL_SIZE) {
+    // Read into a spare buffer when the ring is full, in case a slot is released meanwhile.
+    const int full = head - atomic_load(&pl.tail) > pl.mask;
+    pipeline_slot* slot = &pl.slots[head & pl.mask];
+    char* line = full ? spare : slot->line;
+    const int r = poll_read_line(dev, is_file, line, &line_written, &first, &ret);
+    if (r < 0) {
+      break;
+    }
+    if (r == 0 || verify_line(dev, line, line_written, &entry) < 0) {
+      continue;
+    }
+    if (full) {
+      if (head - atomic_load(&pl.tail) > pl.mask) {
+        // Output is stalled - drop the line rather than stop reading the device.
+        atomic_fetch_add(&pl.dropped, 1);
         continue;
       }
+      memcpy(slot->line, spare, line_written + 1);
+    }
+    slot->len = line_written;
+    slot->host_ns = now_ns();
+    slot->entry = entry;
+    atomic_store(&pl.head, ++head);
+    const size_t depth = head - atomic_load(&pl.tail);
+    if (depth > atomic_load(&pl.depth_max)) {
+      atomic_store(&pl.depth_max, depth);
+    }
+    if (atomic_load(&pl.format_waiting)) {
+      pipeline_notify();
+    }
+    if (count) {
+      running--;
     }
-    assert(line_written > 0);
-    assert(line[line_written - 1] == '\n');
-    // If the line came from the serial port, we should expect `line_written == OSP3_LOG_PROTOCOL_SIZE`.
-    // However, a line from stdin may not include the '\r' prior to the '\n', so we'll try to be forgiving.
-    // Parsing and checksum should still drop bad messages (unless disabled, but that's the user being reckless).
-    if (parse && line_written < OSP3_LOG_PROTOCOL_SIZE - 1) {
-      fprintf(stderr, "Log entry parsing failed (too short): %s", line);
-    } else if (parse && line_written > OSP3_LOG_PROTOCOL_SIZE) {
-      fprintf(stderr, "Log entry parsing failed (too long): %s", line);
-    } else if (parse && osp3_log_parse(line, OSP3_LOG_PROTOCOL_SIZE, &log_entry)) {
-      fprintf(stderr, "Log entry parsing failed (bad format): %s", line);
-    } else if (checksum && osp3_log_checksum(line, OSP3_LOG_PROTOCOL_SIZE, &cs8_2s, &cs8_xor)) {
-      fprintf(stderr, "Log entry checksum failed (cs8_2s=%02x, cs8_xor=%02x): %s", cs8_2s, cs8_xor, line);
+  }
+  atomic_store(&pl.read_done, 1);
+  pipeline_notify();
+  pthread_join(formatter, NULL);
+  pthread_join(writer, NULL);
+  free(pl.slots);
+  const uint64_t dropped = atomic_load(&pl.dropped);
+  if (dropped > 0) {
+    fprintf(stderr, "Dropped %llu log entries (pipeline queue full)\n", (unsigned long long) dropped);
+  }
+  return atomic_load(&pl.write_failed) ? 1 : ret;
+}
+
+static const merge_row* merge_head(const poll_device* d) {
+  return &d->queue[d->queue_head];
+}
+
+static const merge_row* merge_tail(const poll_device* d) {
+  return &d->queue[(d->queue_head + d->queue_len - 1) % MERGE_QUEUE_LEN];
+}
+
+// Rows are merged by time - or by time bucket, when joining.
+static uint64_t merge_key(const merge_row* r) {
+  return align_ms > 0 ? r->host_ns / (align_ms * 1000000ull) : r->host_ns;
+}
+
+// The device with the earliest queued row, if any.
+static poll_device* merge_min(void) {
+  poll_device* min = NULL;
+  for (size_t i = 0; i < ndevices; i++) {
+    if (devices[i].queue_len > 0 && (min == NULL || merge_key(merge_head(&devices[i])) < merge_key(merge_head(min)))) {
+      min = &devices[i];
+    }
+  }
+  return min;
+}
+
+// When rows with a key are final: no device can still deliver an earlier (or, when joining, an equal) key.
+static uint64_t merge_deadline(uint64_t key) {
+  const uint64_t end_ns = align_ms > 0 ? (key + 1) * align_ms * 1000000ull : key;
+  return end_ns + merge_window_ms * 1000000ull;
+}
+
+static int merge_ready(uint64_t key, uint64_t now) {
+  if (now >= merge_deadline(key)) {
+    return 1;
+  }
+  for (size_t i = 0; i < ndevices; i++) {
+    if (devices[i].queue_len == MERGE_QUEUE_LEN) {
+      // Can't wait any longer.
+      return 1;
+    }
+  }
+  // Each device's rows are in order, so once every device has queued a later row, nothing earlier can arrive.
+  for (size_t i = 0; i < ndevices; i++) {
+    if (devices[i].queue_len == 0 || (align_ms > 0 && merge_key(merge_tail(&devices[i])) <= key)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Output merged rows that are ready (or all rows).
+static int merge_emit(int all, uint64_t now) {
+  poll_device* d;
+  while (running && (d = merge_min()) != NULL) {
+    const osp3_log_entry* entries[DEVICES_MAX] = { 0 };
+    const uint64_t key = merge_key(merge_head(d));
+    size_t len;
+    if (!all && !merge_ready(key, now)) {
+      break;
+    }
+    char* dst = out_reserve();
+    if (dst == NULL) {
+      perror("write");
+      return -1;
+    }
+    if (align_ms == 0) {
+      // Popped rows stay intact until the next entry is queued.
+      const merge_row* r = merge_head(d);
+      const unsigned int idx = (unsigned int) (d - devices);
+      d->queue_head = (d->queue_head + 1) % MERGE_QUEUE_LEN;
+      d->queue_len--;
+      entries[idx] = &r->entry;
+      len = format_row(dst, entries, idx, host_us(r->host_ns));
+      if (format == FORMAT_RAW) {
+        memcpy(&dst[len], r->line, r->len);
+        len += r->len;
+      }
     } else {
-      printf("%s", line);
-      if (count) {
-        running--;
+      // Use each device's last entry in the bucket.
+      for (size_t i = 0; i < ndevices; i++) {
+        while (devices[i].queue_len > 0 && merge_key(merge_head(&devices[i])) == key) {
+          entries[i] = &merge_head(&devices[i])->entry;
+          devices[i].queue_head = (devices[i].queue_head + 1) % MERGE_QUEUE_LEN;
+          devices[i].queue_len--;
+        }
+      }
+      len = format_row(dst, entries, 0, host_us(key * align_ms * 1000000ull));
+    }
+    if (out_commit(len) && out_deliver(NULL) < 0) {
+      return -1;
+    }
+    if (count) {
+      running--;
+    }
+  }
+  return 0;
+}
+
+// Read a line from a device that's ready, and queue it for merging if it's valid.
+static int merge_read(poll_device* d) {
+  osp3_log_entry entry;
+  char line[OSP3_LINE_LEN_MAX + 1];
+  size_t line_written = 0;
+  if (read_line(d->dev, (unsigned char*) line, OSP3_LINE_LEN_MAX, &line_written) < 0) {
+    if (!running) {
+      return 0;
+    }
+    if (errno == ETIME) {
+      fprintf(stderr, "Read timeout expired: %s\n", d->path);
+    } else {
+      fprintf(stderr, "read_line: %s: %s\n", d->path, strerror(errno));
+    }
+    return -1;
+  }
+  const uint64_t now = now_ns();
+  d->last_ns = now;
+  if (d->first) {
+    // See `poll_read_line`.
+    d->first = 0;
+    if (line_written < OSP3_LOG_PROTOCOL_SIZE) {
+      return 0;
+    }
+  }
+  line[line_written] = '\0';
+  if (verify_line(d->dev, line, line_written, &entry) < 0) {
+    return 0;
+  }
+  if (d->queue_len == MERGE_QUEUE_LEN && merge_emit(0, now) < 0) {
+    return -1;
+  }
+  merge_row* r = &d->queue[(d->queue_head + d->queue_len) % MERGE_QUEUE_LEN];
+  r->host_ns = align_entry(d, entry.ms, now);
+  r->entry = entry;
+  // Verified lines are never longer than the protocol.
+  r->len = line_written;
+  memcpy(r->line, line, line_written + 1);
+  d->queue_len++;
+  return 0;
+}
+
+static void wait_until(int* wait_ms, uint64_t deadline_ns, uint64_t now) {
+  // Round up, so the deadline has passed when woken.
+  const uint64_t ms = deadline_ns > now ? (deadline_ns - now + 999999) / 1000000 : 0;
+  if (*wait_ms < 0 || ms < (uint64_t) *wait_ms) {
+    *wait_ms = (int) ms;
+  }
+}
+
+// Poll several devices (or join one device's entries into time buckets) from a single event loop.
+static int osp3_poll_multi(void) {
+  struct pollfd pfds[DEVICES_MAX];
+  time_t stats_next = now_s() + stats_interval_s;
+  char label[32];
+  if (out_header() < 0) {
+    return 1;
+  }
+  for (size_t i = 0; i < ndevices; i++) {
+    if (realtime_enter(devices[i].dev) < 0) {
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < ndevices; i++) {
+    pfds[i].fd = osp3_get_fd(devices[i].dev);
+    pfds[i].events = POLLIN;
+    // Opening may have taken a while (e.g., detecting settings).
+    devices[i].last_ns = now_ns();
+  }
+  while (running) {
+    const uint64_t now = now_ns();
+    int wait_ms = -1;
+    if (stats && stats_interval_s > 0 && now_s() >= stats_next) {
+      for (size_t i = 0; i < ndevices; i++) {
+        snprintf(label, sizeof(label), "stats[%zu]", i);
+        print_stats(devices[i].dev, label);
+      }
+      stats_next += stats_interval_s;
+    }
+    for (size_t i = 0; i < ndevices && timeout_ms > 0; i++) {
+      if (now - devices[i].last_ns >= timeout_ms * 1000000ull) {
+        fprintf(stderr, "Read timeout expired: %s\n", devices[i].path);
+        return 1;
+      }
+      wait_until(&wait_ms, devices[i].last_ns + timeout_ms * 1000000ull, now);
+    }
+    if (merge_emit(0, now) < 0) {
+      return 1;
+    }
+    const poll_device* min = merge_min();
+    if (min != NULL) {
+      wait_until(&wait_ms, merge_deadline(merge_key(merge_head(min))), now);
+    }
+    if (out.lines > 0 && flush_ms > 0) {
+      if (now - out.first_ns >= flush_ms * 1000000ull) {
+        if (out_deliver(NULL) < 0) {
+          return 1;
+        }
+      } else {
+        wait_until(&wait_ms, out.first_ns + flush_ms * 1000000ull, now);
+      }
+    }
+    if (stats && stats_interval_s > 0) {
+      wait_until(&wait_ms, now + (uint64_t) (stats_next - now_s()) * 1000000000ull, now);
+    }
+    if (!running) {
+      break;
+    }
+    const int ready = poll(pfds, ndevices, wait_ms);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      perror("poll");
+      return 1;
+    }
+    for (size_t i = 0; i < ndevices && ready > 0 && running; i++) {
+      if (pfds[i].revents != 0 && merge_read(&devices[i]) < 0) {
+        return 1;
       }
     }
   }
   return 0;
 }
 
+// The process's own overhead, per line read from all devices.
+static void print_self(osp3_device* const* devs, size_t n) {
+  osp3_self_stats self;
+  osp3_self_stats dev_self;
+  uint64_t lines = 0;
+  if (osp3_self_stats_get(devs[0], &self) < 0) {
+    perror("osp3_self_stats_get");
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (osp3_self_stats_get(devs[i], &dev_self) == 0) {
+      lines += dev_self.lines;
+    }
+  }
+  // Avoid dividing by zero.
+  const double per = lines > 0 ? (double) lines : 1.0;
+  fprintf(stderr, "self: elapsed_ms=%.1f cpu_ms=%.3f cpu_pct=%.3f user_ms=%.3f system_ms=%.3f "
+          "voluntary_switches=%llu involuntary_switches=%llu lines=%llu cpu_us_per_line=%.2f "
+          "voluntary_switches_per_line=%.3f involuntary_switches_per_line=%.3f\n",
+          (double) self.elapsed_ns / 1e6, (double) self.cpu_ns / 1e6,
+          self.elapsed_ns > 0 ? 100.0 * (double) self.cpu_ns / (double) self.elapsed_ns : 0.0,
+          (double) self.user_ns / 1e6, (double) self.system_ns / 1e6,
+          (unsigned long long) self.voluntary_switches, (unsigned long long) self.involuntary_switches,
+          (unsigned long long) lines, (double) self.cpu_ns / 1e3 / per, (double) self.voluntary_switches / per,
+          (double) self.involuntary_switches / per);
+}
+
+static void print_latency(const osp3_device* dev, const char* label) {
+  static const char* const stage_names[OSP3_LATENCY_STAGE_COUNT] = {
+    [OSP3_LATENCY_STAGE_ASSEMBLY] = "assembly",
+    [OSP3_LATENCY_STAGE_PARSE] = "parse",
+    [OSP3_LATENCY_STAGE_DELIVERY] = "delivery",
+    [OSP3_LATENCY_STAGE_TOTAL] = "total",
+  };
+  osp3_latency_stats lat;
+  fprintf(stderr, "%-10s %10s %12s %12s %12s\n", label, "count", "p50_us", "p99_us", "max_us");
+  for (int i = 0; i < OSP3_LATENCY_STAGE_COUNT; i++) {
+    if (osp3_latency_get(dev, (osp3_latency_stage) i, &lat) == 0) {
+      fprintf(stderr, "%-10s %10llu %12.1f %12.1f %12.1f\n", stage_names[i], (unsigned long long) lat.count,
+              (double) lat.p50_ns / 1000.0, (double) lat.p99_ns / 1000.0, (double) lat.max_ns / 1000.0);
+    }
+  }
+}
+
+// Open a device, detecting its settings if requested.
+static osp3_device* open_device(const char* path) {
+  static int derived = 0;
+  osp3_probe_info info;
+  osp3_device* dev;
+  if (!probe) {
+    dev = osp3_open_path(path, baud);
+  } else if ((dev = osp3_open_path_probe(path, 0, &info)) == NULL) {
+    return NULL;
+  }
+  if (dev != NULL && predict && osp3_set_schedule(dev, OSP3_SCHEDULE_PREDICT) < 0) {
+    osp3_close(dev);
+    return NULL;
+  }
+  if (!probe) {
+    return dev;
+  }
+  fprintf(stderr, "%s: baud=%u interval_ms=%u timeout_ms=%u\n", path, info.baud, info.interval_ms, info.timeout_ms);
+  // With multiple devices, settings must suit the slowest.
+  if (!timeout_set && (!derived || info.timeout_ms > timeout_ms)) {
+    timeout_ms = info.timeout_ms;
+  }
+  if (pipeline_slots > 0 && !pipeline_slots_set) {
+    const size_t slots = PIPELINE_SLOTS_DEFAULT * OSP3_INTERVAL_MS_MIN / info.interval_ms;
+    pipeline_slots = slots > PIPELINE_SLOTS_MIN ? slots : PIPELINE_SLOTS_MIN;
+  }
+  derived = 1;
+  return dev;
+}
+
 int main(int argc, char** argv) {
   osp3_device* dev = NULL;
+  char label[32];
   int ret;
 
-  // Flushing lines improves streaming performance when stdout is non-interactive, e.g., piped to another process.
-  // This enables better (soft) real-time pipeline processing.
-  setlinebuf(stdout);
-
   parse_args(argc, argv);
+  if (flush_lines == 0 && flush_bytes == 0 && flush_ms == 0 && coalesce_ms > 0) {
+    // Writing each line would wake the consumer for every line anyway.
+    flush_ms = coalesce_ms;
+  } else if (flush_lines == 0 && flush_bytes == 0 && flush_ms == 0) {
+    // Flushing lines improves streaming performance when stdout is non-interactive, e.g., piped to another process.
+    // This enables better (soft) real-time pipeline processing.
+    flush_lines = 1;
+  }
+  const int is_stdin = path_stdin || (npaths == 0 && !isatty(0));
+  const int multi = npaths > 1 || align_ms > 0;
+  latency_marks = latency && pipeline_slots == 0 && !multi;
+  if (!columns_set) {
+    for (size_t i = COL_MS; i <= COL_CS8_XOR; i++) {
+      columns[ncolumns++] = (column_id) i;
+    }
+  }
+  if ((columns_set || si_units || align_ms > 0) && !format_set) {
+    format = FORMAT_CSV;
+  }
+  if (format != FORMAT_RAW && !parse) {
+    fprintf(stderr, "Output format '%s' requires parsing\n", format_names[format]);
+    return 1;
+  }
+  if (format == FORMAT_RAW && (columns_set || si_units)) {
+    fprintf(stderr, "Raw output doesn't support --columns or --si\n");
+    return 1;
+  }
+  if (multi && (is_stdin || pipeline_slots > 0)) {
+    fprintf(stderr, "Multiple devices and --align don't support standard input or --pipeline\n");
+    return 1;
+  }
+  if (coalesce_ms > 0 && multi) {
+    // Merging waits on all devices at once.
+    fprintf(stderr, "Multiple devices and --align don't support --coalesce\n");
+    return 1;
+  }
+  if (follow && (npaths != 1 || path_stdin || align_ms > 0)) {
+    fprintf(stderr, "--follow requires a single file path\n");
+    return 1;
+  }
+  if (align_ms > 0 && (format == FORMAT_RAW || format == FORMAT_BINARY)) {
+    fprintf(stderr, "Output format '%s' doesn't support --align\n", format_names[format]);
+    return 1;
+  }
+  if (align_ms > 0) {
+    // The bucket's time, then each device's columns.
+    fields[nfields++] = (field) { COL_HOST_US, -1 };
+    for (size_t d = 0; d < npaths; d++) {
+      for (size_t i = 0; i < ncolumns; i++) {
+        if (columns[i] != COL_DEV && columns[i] != COL_HOST_US) {
+          fields[nfields++] = (field) { columns[i], (int) d };
+        }
+      }
+    }
+  } else {
+    if (multi && !columns_set) {
+      fields[nfields++] = (field) { COL_DEV, -1 };
+      fields[nfields++] = (field) { COL_HOST_US, -1 };
+    }
+    for (size_t i = 0; i < ncolumns && format != FORMAT_RAW; i++) {
+      fields[nfields++] = (field) { columns[i], -1 };
+    }
+  }
+  format_init();
+  if (pipeline_slots > 0 && row_len_max > OSP3_LINE_LEN_MAX) {
+    fprintf(stderr, "Too many columns for --pipeline\n");
+    return 1;
+  }
 
-  if (path_set || (isatty(0) && path != NULL && strlen(path) > 0 && strcmp(path, "-"))) {
+  start_ns = now_ns();
+  if (multi) {
+    if (npaths == 0) {
+      paths[npaths++] = PATH_DEFAULT;
+    }
     signal(SIGINT, shandle);
-    if ((dev = osp3_open_path(path, baud)) == NULL) {
+    for (ndevices = 0; ndevices < npaths; ndevices++) {
+      poll_device* d = &devices[ndevices];
+      d->path = paths[ndevices];
+      d->first = 1;
+      if ((d->dev = open_device(d->path)) == NULL) {
+        fprintf(stderr, "Failed to open ODROID Smart Power 3 connection: %s: %s\n", d->path, strerror(errno));
+        ret = 1;
+        goto close;
+      }
+      if (latency && osp3_latency_reset(d->dev) < 0) {
+        fprintf(stderr, "Latency instrumentation is unavailable: %s\n", strerror(errno));
+        ndevices++;
+        ret = 1;
+        goto close;
+      }
+    }
+    for (size_t i = 0; self_stats && i < ndevices; i++) {
+      // The whole process, since merging reads every device from one thread.
+      if (osp3_self_stats_reset(devices[i].dev, OSP3_SELF_PROCESS) < 0) {
+        perror("osp3_self_stats_reset");
+        ret = 1;
+        goto close;
+      }
+    }
+    ret = osp3_poll_multi();
+    if (merge_emit(1, now_ns()) < 0 || out_deliver(NULL) < 0) {
+      ret = 1;
+    }
+    for (size_t i = 0; i < ndevices; i++) {
+      snprintf(label, sizeof(label), "latency[%zu]", i);
+      if (latency) {
+        print_latency(devices[i].dev, label);
+      }
+      snprintf(label, sizeof(label), "stats[%zu]", i);
+      if (stats) {
+        print_stats(devices[i].dev, label);
+      }
+    }
+    if (self_stats) {
+      osp3_device* devs[DEVICES_MAX];
+      for (size_t i = 0; i < ndevices; i++) {
+        devs[i] = devices[i].dev;
+      }
+      print_self(devs, ndevices);
+    }
+close:
+    for (size_t i = 0; i < ndevices; i++) {
+      if (osp3_close(devices[i].dev)) {
+        perror("Failed to close ODROID Smart Power 3 connection");
+      }
+    }
+    return ret;
+  }
+
+  if (follow) {
+    signal(SIGINT, shandle);
+    if ((dev = osp3_open_follow(paths[0], follow == FOLLOW_END)) == NULL) {
+      fprintf(stderr, "Failed to follow file: %s: %s\n", paths[0], strerror(errno));
+      return 1;
+    }
+  } else if (!is_stdin) {
+    signal(SIGINT, shandle);
+    if ((dev = open_device(npaths > 0 ? paths[0] : PATH_DEFAULT)) == NULL) {
       perror("Failed to open ODROID Smart Power 3 connection");
       return 1;
     }
+  } else if ((dev = osp3_open_fd(STDIN_FILENO)) == NULL) {
+    perror("Failed to open standard input");
+    return 1;
+  }
+  if (latency && osp3_latency_reset(dev) < 0) {
+    fprintf(stderr, "Latency instrumentation is unavailable: %s\n", strerror(errno));
+    osp3_close(dev);
+    return 1;
+  }
+  if (coalesce_ms > 0 && osp3_set_coalesce(dev, coalesce_ms) < 0) {
+    perror("osp3_set_coalesce");
+    osp3_close(dev);
+    return 1;
+  }
+  // The whole process, including pipeline threads.
+  if (self_stats && osp3_self_stats_reset(dev, OSP3_SELF_PROCESS) < 0) {
+    perror("osp3_self_stats_reset");
+    osp3_close(dev);
+    return 1;
   }
 
-  ret = osp3_poll(dev);
+  const int is_file = is_stdin || follow;
+  ret = pipeline_slots > 0 ? osp3_poll_pipeline(dev, is_file) : osp3_poll(dev, is_file);
+  if (out_deliver(dev) < 0) {
+    ret = 1;
+  }
+
+  if (latency) {
+    print_latency(dev, "latency");
+  }
+  if (stats) {
+    print_stats(dev, "stats");
+  }
+  if (self_stats) {
+    print_self(&dev, 1);
+  }
 
-  if (dev != NULL && osp3_close(dev)) {
+  if (osp3_close(dev)) {
     perror("Failed to close ODROID Smart Power 3 connection");
   }
 
@@ -0,0 +1,481 @@
+/**
+ * Live terminal dashboard for an ODROID Smart Power 3.
+ *
+ * A reader thread reads and verifies log entries and updates statistics incrementally, so its per-entry work is
+ * constant, while the main thread redraws at a capped rate, rewriting only the rows that changed.
+ *
+ * @author Connor Imes
+ * @date 2026-10-17
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <osp3.h>
+
+#define PATH_DEFAULT "/dev/ttyUSB0"
+
+#define TIMEOUT_MS_DEFAULT 2000
+
+#define REFRESH_MS_DEFAULT 500
+// Redrawing faster than this is unreadable anyway.
+#define REFRESH_MS_MIN 50
+
+#define WINDOW_S_DEFAULT 10
+
+// The rolling window advances in steps of 1/WINDOW_BUCKETS of its length.
+#define WINDOW_BUCKETS 20
+
+#define LINE_LEN_MAX (2 * OSP3_LOG_PROTOCOL_SIZE)
+
+#define ROWS 10
+#define ROW_LEN 128
+// Large enough for any milli-unit value.
+#define FMT_LEN 32
+
+typedef enum channel {
+  CH_IN,
+  CH_0,
+  CH_1,
+  CH_COUNT,
+} channel;
+
+typedef struct channel_stats {
+  // The latest entry.
+  unsigned int mV;
+  unsigned int mA;
+  unsigned int mW;
+  unsigned int onoff;
+  unsigned int intr;
+  // Since start.
+  unsigned int mW_min;
+  unsigned int mW_max;
+  uint64_t uJ;
+  uint64_t intr_entries;
+  // Rolling window.
+  uint64_t window_mW_sum;
+  uint64_t bucket_mW_sum[WINDOW_BUCKETS];
+} channel_stats;
+
+// Shared between the reader thread and the display thread.
+static struct {
+  pthread_mutex_t lock;
+  channel_stats ch[CH_COUNT];
+  uint64_t entries;
+  unsigned long ms;
+  int ms_valid;
+  // The rolling window's current bucket (in device time), and entry counts.
+  unsigned long bucket;
+  unsigned long window_entries;
+  unsigned long bucket_entries[WINDOW_BUCKETS];
+  // Read errors - the reader stops on anything other than a timeout.
+  uint64_t read_timeouts;
+  int read_errno;
+  int done;
+} top = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static const char* path = PATH_DEFAULT;
+static unsigned int baud = OSP3_BAUD_DEFAULT;
+static unsigned int timeout_ms = TIMEOUT_MS_DEFAULT;
+static unsigned int refresh_ms = REFRESH_MS_DEFAULT;
+static unsigned int window_s = WINDOW_S_DEFAULT;
+static unsigned long bucket_ms;
+static volatile sig_atomic_t running = 1;
+static volatile sig_atomic_t resized = 0;
+
+static const char short_options[] = "hp:b:t:r:w:";
+static const struct option long_options[] = {
+  {"help",      no_argument,       NULL, 'h'},
+  {"path",      required_argument, NULL, 'p'},
+  {"baud",      required_argument, NULL, 'b'},
+  {"timeout",   required_argument, NULL, 't'},
+  {"refresh",   required_argument, NULL, 'r'},
+  {"window",    required_argument, NULL, 'w'},
+  {0, 0, 0, 0}
+};
+
+__attribute__ ((noreturn))
+static void print_usage(int exit_code) {
+  fprintf(exit_code ? stderr : stdout,
+          "Show live power, interrupt flags, sample rate, and error counts from an ODROID Smart Power 3.\n\n"
+          "Usage: osp3-top [OPTION]...\n"
+          "Options:\n"
+          "  -h, --help               Print this message and exit\n"
+          "  -p, --path=FILE          Device path (default: %s);\n"
+          "                           \"-\" uses standard input\n"
+          "  -b, --baud=RATE          Device baud rate (default: %u)\n"
+          "  -t, --timeout=MS         Read timeout in milliseconds (default: %u)\n"
+          "                           Use 0 for blocking read\n"
+          "  -r, --refresh=MS         Redraw interval in milliseconds (default: %u, minimum: %u)\n"
+          "  -w, --window=SEC         Rolling average window in seconds (default: %u)\n",
+          PATH_DEFAULT, OSP3_BAUD_DEFAULT, TIMEOUT_MS_DEFAULT, REFRESH_MS_DEFAULT, REFRESH_MS_MIN, WINDOW_S_DEFAULT);
+  exit(exit_code);
+}
+
+static void parse_args(int argc, char** argv) {
+  int c;
+  while ((c = getopt_long(argc, argv, short_options, long_options, NULL)) != -1) {
+    switch (c) {
+      case 'h':
+        print_usage(0);
+        break;
+      case 'p':
+        path = optarg;
+        break;
+      case 'b':
+        baud = (unsigned int) atoi(optarg);
+        break;
+      case 't':
+        timeout_ms = (unsigned int) atoi(optarg);
+        break;
+      case 'r':
+        refresh_ms = (unsigned int) atoi(optarg);
+        if (refresh_ms < REFRESH_MS_MIN) {
+          refresh_ms = REFRESH_MS_MIN;
+        }
+        break;
+      case 'w':
+        window_s = (unsigned int) atoi(optarg);
+        if (window_s == 0) {
+          print_usage(1);
+        }
+        break;
+      case '?':
+      default:
+        print_usage(1);
+        break;
+    }
+  }
+}
+
+static void shandle(int sig) {
+  switch (sig) {
+    case SIGTERM:
+    case SIGINT:
+#ifdef SIGQUIT
+    case SIGQUIT:
+#endif
+#ifdef SIGHUP
+    case SIGHUP:
+#endif
+      running = 0;
+      break;
+#ifdef SIGWINCH
+    case SIGWINCH:
+      resized = 1;
+      break;
+#endif
+    default:
+      break;
+  }
+}
+
+static void channel_update(channel_stats* c, unsigned int mV, unsigned int mA, unsigned int mW, unsigned int onoff,
+                           unsigned int intr, unsigned long delta_ms, unsigned int b, int first) {
+  c->mV = mV;
+  c->mA = mA;
+  c->mW = mW;
+  c->onoff = onoff;
+  c->intr = intr;
+  if (first || mW < c->mW_min) {
+    c->mW_min = mW;
+  }
+  if (mW > c->mW_max) {
+    c->mW_max = mW;
+  }
+  // Power is assumed constant since the previous entry.
+  c->uJ += (uint64_t) mW * delta_ms;
+  if (intr) {
+    c->intr_entries++;
+  }
+  c->window_mW_sum += mW;
+  c->bucket_mW_sum[b] += mW;
+}
+
+static void window_clear(unsigned int b) {
+  for (size_t i = 0; i < CH_COUNT; i++) {
+    top.ch[i].window_mW_sum -= top.ch[i].bucket_mW_sum[b];
+    top.ch[i].bucket_mW_sum[b] = 0;
+  }
+  top.window_entries -= top.bucket_entries[b];
+  top.bucket_entries[b] = 0;
+}
+
+// Called with the lock held - only constant work per entry.
+static void top_update(const osp3_log_entry* e) {
+  const int first = top.entries == 0;
+  unsigned long delta_ms = 0;
+  const unsigned long bucket = e->ms / bucket_ms;
+  if (!top.ms_valid || e->ms < top.ms) {
+    // The first entry, or the device was reset - restart the window.
+    for (unsigned int b = 0; b < WINDOW_BUCKETS; b++) {
+      window_clear(b);
+    }
+  } else {
+    delta_ms = e->ms - top.ms;
+    // Expire buckets that the window moved past (at most all of them).
+    for (unsigned long b = top.bucket + 1; b <= bucket && b <= top.bucket + WINDOW_BUCKETS; b++) {
+      window_clear((unsigned int) (b % WINDOW_BUCKETS));
+    }
+  }
+  top.ms = e->ms;
+  top.ms_valid = 1;
+  top.bucket = bucket;
+  const unsigned int b = (unsigned int) (bucket % WINDOW_BUCKETS);
+  channel_update(&top.ch[CH_IN], e->mV_in, e->mA_in, e->mW_in, e->onoff_in, 0, delta_ms, b, first);
+  channel_update(&top.ch[CH_0], e->mV_0, e->mA_0, e->mW_0, e->onoff_0, e->intr_0, delta_ms, b, first);
+  channel_update(&top.ch[CH_1], e->mV_1, e->mA_1, e->mW_1, e->onoff_1, e->intr_1, delta_ms, b, first);
+  top.window_entries++;
+  top.bucket_entries[b]++;
+  top.entries++;
+}
+
+static void* top_read(void* arg) {
+  osp3_device* dev = (osp3_device*) arg;
+  unsigned char line[LINE_LEN_MAX + 1];
+  osp3_log_entry entry;
+  size_t transferred;
+  size_t discarded;
+  int first = 1;
+  int err = 0;
+  while (running) {
+    if (osp3_read_line_resync(dev, line, LINE_LEN_MAX, &transferred, &discarded, timeout_ms) < 0) {
+      if (errno == ETIME) {
+        pthread_mutex_lock(&top.lock);
+        top.read_timeouts++;
+        pthread_mutex_unlock(&top.lock);
+        continue;
+      }
+      if (running && errno != ENODATA) {
+        err = errno;
+      }
+      break;
+    }
+    line[transferred] = '\0';
+    if (first) {
+      // The first line is often incomplete.
+      first = 0;
+      if (transferred < OSP3_LOG_PROTOCOL_SIZE) {
+        continue;
+      }
+    }
+    // Verification also records failures in the device's counters.
+    if (osp3_log_verify(dev, (const char*) line, transferred, &entry) == 0) {
+      pthread_mutex_lock(&top.lock);
+      top_update(&entry);
+      pthread_mutex_unlock(&top.lock);
+    }
+  }
+  pthread_mutex_lock(&top.lock);
+  top.read_errno = err;
+  top.done = 1;
+  pthread_mutex_unlock(&top.lock);
+  return NULL;
+}
+
+// Milli-units with three decimal places.
+static void fmt_milli(char* dst, size_t len, uint64_t milli) {
+  snprintf(dst, len, "%"PRIu64".%03"PRIu64, milli / 1000, milli % 1000);
+}
+
+__attribute__ ((format (printf, 3, 4)))
+static void row_printf(char rows[ROWS][ROW_LEN], size_t* nrows, const char* fmt, ...) {
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(rows[(*nrows)++], ROW_LEN, fmt, ap);
+  va_end(ap);
+}
+
+static size_t top_render(char rows[ROWS][ROW_LEN], const osp3_device* dev, double rate, uint64_t uptime_s) {
+  static const char* const ch_names[CH_COUNT] = { "in", "0", "1" };
+  char v[FMT_LEN], a[FMT_LEN], w[FMT_LEN], avg[FMT_LEN], min[FMT_LEN], max[FMT_LEN], j[FMT_LEN];
+  osp3_stats st;
+  osp3_self_stats self;
+  size_t nrows = 0;
+  memset(&st, 0, sizeof(st));
+  osp3_get_stats(dev, &st);
+  pthread_mutex_lock(&top.lock);
+  row_printf(rows, &nrows, "osp3-top - %s  up %02"PRIu64":%02"PRIu64":%02"PRIu64"  %.1f entries/s  ms %010lu%s%s",
+             path, uptime_s / 3600, uptime_s / 60 % 60, uptime_s % 60, rate, top.ms,
+             top.done ? (top.read_errno ? "  read error: " : "  [end of data]") : "",
+             top.done && top.read_errno ? strerror(top.read_errno) : "");
+  row_printf(rows, &nrows, "%s", "");
+  row_printf(rows, &nrows, "%-4s %3s %9s %9s %9s %9s %9s %9s %12s %4s %8s", "CH", "ON", "V", "A", "W", "AVG_W",
+             "MIN_W", "MAX_W", "J", "INTR", "INTR_N");
+  for (size_t i = 0; i < CH_COUNT; i++) {
+    const channel_stats* c = &top.ch[i];
+    fmt_milli(v, sizeof(v), c->mV);
+    fmt_milli(a, sizeof(a), c->mA);
+    fmt_milli(w, sizeof(w), c->mW);
+    fmt_milli(avg, sizeof(avg), top.window_entries > 0 ? c->window_mW_sum / top.window_entries : 0);
+    fmt_milli(min, sizeof(min), c->mW_min);
+    fmt_milli(max, sizeof(max), c->mW_max);
+    // Microjoules to millijoules.
+    fmt_milli(j, sizeof(j), c->uJ / 1000);
+    if (i == CH_IN) {
+      row_printf(rows, &nrows, "%-4s %3u %9s %9s %9s %9s %9s %9s %12s %4s %8s", ch_names[i], c->onoff, v, a, w, avg,
+                 min, max, j, "-", "-");
+    } else {
+      row_printf(rows, &nrows, "%-4s %3u %9s %9s %9s %9s %9s %9s %12s %4u %8"PRIu64, ch_names[i], c->onoff, v, a, w,
+                 avg, min, max, j, c->intr, c->intr_entries);
+    }
+  }
+  row_printf(rows, &nrows, "%s", "");
+  row_printf(rows, &nrows, "entries %"PRIu64"  window %us  read timeouts %"PRIu64, top.entries, window_s,
+             top.read_timeouts);
+  pthread_mutex_unlock(&top.lock);
+  row_printf(rows, &nrows, "errors: parse %"PRIu64"  checksum %"PRIu64"  gaps %"PRIu64"  resets %"PRIu64
+             "  oversize %"PRIu64"  overruns %"PRIu64, st.parse_failures, st.checksum_failures, st.ms_gaps,
+             st.ms_resets, st.lines_oversize, st.overruns + st.buf_overruns);
+  if (osp3_self_stats_get(dev, &self) == 0) {
+    const double per = self.lines > 0 ? (double) self.lines : 1.0;
+    row_printf(rows, &nrows, "self: cpu %.2f%%  %.1f us/entry  wakeups %.2f/entry  preemptions %"PRIu64,
+               self.elapsed_ns > 0 ? 100.0 * (double) self.cpu_ns / (double) self.elapsed_ns : 0.0,
+               (double) self.cpu_ns / 1e3 / per, (double) self.voluntary_switches / per, self.involuntary_switches);
+  }
+  return nrows;
+}
+
+static int write_all(const char* buf, size_t len) {
+  while (len > 0) {
+    ssize_t written = write(STDOUT_FILENO, buf, len);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    buf += written;
+    len -= (size_t) written;
+  }
+  return 0;
+}
+
+// Rewrite only the rows that changed since the previous frame, in a single write.
+static int top_draw(char rows[ROWS][ROW_LEN], char prev[ROWS][ROW_LEN], size_t nrows, int all) {
+  char buf[ROWS * (ROW_LEN + 16) + 16];
+  size_t len = 0;
+  if (all) {
+    // Clear the screen.
+    len += (size_t) snprintf(&buf[len], sizeof(buf) - len, "\033[H\033[2J");
+  }
+  for (size_t i = 0; i < nrows; i++) {
+    if (all || strcmp(rows[i], prev[i])) {
+      // Move to the row, write it, and erase any longer remainder.
+      len += (size_t) snprintf(&buf[len], sizeof(buf) - len, "\033[%zu;1H%s\033[K", i + 1, rows[i]);
+      memcpy(prev[i], rows[i], ROW_LEN);
+    }
+  }
+  return len > 0 ? write_all(buf, len) : 0;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static int top_display(const osp3_device* dev) {
+  char rows[ROWS][ROW_LEN];
+  char prev[ROWS][ROW_LEN];
+  const uint64_t start_ns = now_ns();
+  uint64_t next_ns = start_ns;
+  uint64_t entries_prev = 0;
+  uint64_t prev_ns = start_ns;
+  double rate = 0;
+  int all = 1;
+  // Use the alternate screen and hide the cursor.
+  if (write_all("\033[?1049h\033[?25l", 14) < 0) {
+    return -1;
+  }
+  // Keep showing the final statistics after the reader stops, until interrupted.
+  while (running) {
+    const uint64_t now = now_ns();
+    pthread_mutex_lock(&top.lock);
+    const uint64_t entries = top.entries;
+    pthread_mutex_unlock(&top.lock);
+    if (now > prev_ns) {
+      rate = (double) (entries - entries_prev) * 1e9 / (double) (now - prev_ns);
+    }
+    entries_prev = entries;
+    prev_ns = now;
+    if (resized) {
+      resized = 0;
+      all = 1;
+    }
+    const size_t nrows = top_render(rows, dev, rate, (now - start_ns) / 1000000000ull);
+    if (top_draw(rows, prev, nrows, all) < 0) {
+      return -1;
+    }
+    all = 0;
+    // Keep a fixed cadence regardless of how long drawing took.
+    next_ns += refresh_ms * 1000000ull;
+    const struct timespec ts = {
+      .tv_sec = (time_t) (next_ns / 1000000000ull),
+      .tv_nsec = (long) (next_ns % 1000000000ull),
+    };
+    while (running && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && !resized);
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  osp3_device* dev;
+  pthread_t reader;
+  int ret = 0;
+
+  parse_args(argc, argv);
+  bucket_ms = (unsigned long) window_s * 1000 / WINDOW_BUCKETS;
+
+  if (!strcmp(path, "-")) {
+    dev = osp3_open_fd(STDIN_FILENO);
+  } else {
+    dev = osp3_open_path(path, baud);
+  }
+  if (dev == NULL) {
+    perror("Failed to open ODROID Smart Power 3 connection");
+    return 1;
+  }
+  signal(SIGINT, shandle);
+  signal(SIGTERM, shandle);
+#ifdef SIGWINCH
+  signal(SIGWINCH, shandle);
+#endif
+
+  // Both threads count as overhead - the display wakes for every refresh.
+  osp3_self_stats_reset(dev, OSP3_SELF_PROCESS);
+  if ((errno = pthread_create(&reader, NULL, top_read, dev)) != 0) {
+    perror("pthread_create");
+    osp3_close(dev);
+    return 1;
+  }
+  if (top_display(dev) < 0) {
+    perror("write");
+    ret = 1;
+  }
+  // Leave the alternate screen, so the final frame is lost, but the terminal is restored.
+  write_all("\033[?25h\033[?1049l", 14);
+  // Interrupt the reader's wait, in case the signal was delivered to this thread.
+  running = 0;
+  pthread_kill(reader, SIGINT);
+  pthread_join(reader, NULL);
+  if (top.read_errno) {
+    fprintf(stderr, "read_line: %s\n", strerror(top.read_errno));
+    ret = 1;
+  }
+
+  if (osp3_close(dev)) {
+    perror("Failed to close ODROID Smart Power 3 connection");
+  }
+
+  return ret;
+}